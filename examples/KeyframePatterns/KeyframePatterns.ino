@@ -0,0 +1,94 @@
+/**
+ *   Keyframe Patterns for the StrokeEngine
+ *   Adds two patterns defined by data only to the pattern registry and cycles
+ *   through them. Stairway moves in with two stops on the way and out in one
+ *   go, Ripple makes two short ripples at the deepest point. Use them as a
+ *   template for your own keyframe patterns.
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <Arduino.h>
+#include <StrokeEngine.h>
+
+#define RUN_MS              20000     // Time each pattern runs
+
+static motorProperties servoMotor {
+  .maxSpeed = 2000.0,
+  .maxAcceleration = 100000.0,
+  .stepsPerMillimeter = 50.0,
+  .invertDirection = false,
+  .enableActiveLow = true,
+  .stepPin = 4,
+  .directionPin = 16,
+  .enablePin = 17
+};
+
+static machineGeometry strokingMachine = {
+  .physicalTravel = 160.0,
+  .keepoutBoundary = 5.0
+};
+
+StrokeEngine Stroker;
+
+// Columns are position [%], duration weight, easing, position shift and 
+// duration change at sensation 100.
+
+// Moves in with two stops on the way and out in one go. Sensation > 0 speeds 
+// up the steps in and slows down the way out.
+static const keyframe stairwayKeyframes[] = {
+  {33, 1, EASE_SMOOTH, 0, -50},
+  {66, 1, EASE_SMOOTH, 0, -50},
+  {100, 1, EASE_SMOOTH, 0, -50},
+  {0, 3, EASE_SMOOTH, 0, 50}
+};
+static KeyframePattern stairway("Stairway", stairwayKeyframes, sizeof(stairwayKeyframes) / sizeof(keyframe));
+REGISTER_PATTERN_INSTANCE(stairway);
+
+// Full stroke in, two short ripples at the deepest point and back out. 
+// Sensation > 0 makes the ripples deeper.
+static const keyframe rippleKeyframes[] = {
+  {100, 3, EASE_SMOOTH, 0, 0},
+  {80, 1, EASE_LINEAR, -15, 0},
+  {100, 1, EASE_LINEAR, 0, 0},
+  {80, 1, EASE_LINEAR, -15, 0},
+  {100, 1, EASE_LINEAR, 0, 0},
+  {0, 3, EASE_SMOOTH, 0, 0}
+};
+static KeyframePattern ripple("Ripple", rippleKeyframes, sizeof(rippleKeyframes) / sizeof(keyframe));
+REGISTER_PATTERN_INSTANCE(ripple);
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Stroker.begin(&strokingMachine, &servoMotor);
+  Stroker.thisIsHome();
+  delay(2000);
+
+  Stroker.setDepth(150.0, false);
+  Stroker.setStroke(100.0, false);
+  Stroker.setSpeed(30.0, false);
+  Stroker.setSensation(0.0, false);
+
+  for (unsigned int i = 0; i < Stroker.getNumberOfPattern(); i++) {
+    Serial.printf("%2u: %s\n", i, Stroker.getPatternName(i).c_str());
+  }
+}
+
+void loop() {
+  // The registered patterns follow the built-in ones
+  static unsigned int index = Stroker.getNumberOfPattern() - 2;
+
+  Serial.println("Running " + Stroker.getPatternName(index));
+  Stroker.setPattern(index, false);
+  Stroker.startPattern();
+  delay(RUN_MS);
+  Stroker.stopMotion();
+  delay(2000);
+
+  index = (index + 1 < Stroker.getNumberOfPattern()) ? index + 1 : Stroker.getNumberOfPattern() - 2;
+}
@@ -0,0 +1,130 @@
+/**
+ *   Parameter Benchmark for the StrokeEngine
+ *   Runs a pattern once undisturbed and once while a task on core 0 moves
+ *   speed, depth, stroke and sensation like a UI slider firing hundreds of
+ *   updates per second. The set-functions publish a snapshot without taking
+ *   the pattern mutex, so the stroking task must not miss a single cycle.
+ *   A third run sends the same storm with applyNow = true, which must be 
+ *   merged into at most one re-plan every REPLAN_INTERVAL_MS. Reports the
+ *   motion statistics and update counters of all runs. No servo or stepper
+ *   needs to be connected. Needs STROKEENGINE_STATS defined in StrokeEngine.h.
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <Arduino.h>
+#include <StrokeEngine.h>
+
+#ifndef STROKEENGINE_STATS
+#error "Uncomment #define STROKEENGINE_STATS in StrokeEngine.h to run this benchmark"
+#endif
+
+#define RUN_MS              20000     // Duration of each run
+#define STROKES_PER_MINUTE  120.0     // Nominal speed, the storm varies it by +/-20%
+#define SLIDER_PERIOD_MS    2         // Interval between two updates of the slider storm
+
+static motorProperties servoMotor {
+  .maxSpeed = 2000.0,
+  .maxAcceleration = 100000.0,
+  .stepsPerMillimeter = 50.0,
+  .invertDirection = false,
+  .enableActiveLow = true,
+  .stepPin = 4,
+  .directionPin = 16,
+  .enablePin = 17
+};
+
+static machineGeometry strokingMachine = {
+  .physicalTravel = 160.0,
+  .keepoutBoundary = 5.0
+};
+
+StrokeEngine Stroker;
+
+static volatile bool storming = false;
+static volatile bool applyNow = false;
+
+// Sweeps all sliders back and forth as fast as a UI would send them
+void sliderStorm(void *parameter) {
+  uint32_t step = 0;
+  while (true) {
+    if (storming) {
+      float sweep = float(step % 200) / 100.0;
+      if (sweep > 1.0) {
+        sweep = 2.0 - sweep;
+      }
+      switch (step % 4) {
+        case 0: Stroker.setSpeed(STROKES_PER_MINUTE * (0.8 + 0.4 * sweep), applyNow); break;
+        case 1: Stroker.setDepth(130.0 + 20.0 * sweep, applyNow); break;
+        case 2: Stroker.setStroke(80.0 + 20.0 * sweep, applyNow); break;
+        case 3: Stroker.setSensation(-50.0 + 100.0 * sweep, applyNow); break;
+      }
+      step++;
+    }
+    vTaskDelay(SLIDER_PERIOD_MS / portTICK_PERIOD_MS);
+  }
+}
+
+motionStats runPattern(bool storm, bool now, updateCounters &counters) {
+  Stroker.resetStats();
+  Stroker.resetUpdateCounters();
+  applyNow = now;
+  storming = storm;
+
+  Stroker.startPattern();
+  delay(RUN_MS);
+  storming = false;
+  Stroker.stopMotion();
+  Stroker.waitForStop();
+
+  counters = Stroker.getUpdateCounters();
+  return Stroker.getStats();
+}
+
+void printResult(const char *name, const motionStats &stats, const updateCounters &counters) {
+  Serial.printf("%-8s %8u %8u %8u %8u %8u %8u %12u %12u\n", name, unsigned(counters.received), 
+    unsigned(counters.applied), unsigned(counters.replanRequests), unsigned(counters.replans), 
+    unsigned(stats.moves), unsigned(stats.mutexMisses), unsigned(stats.moveGap.percentile(99)), 
+    unsigned(stats.moveGap.max()));
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Stroker.begin(&strokingMachine, &servoMotor);
+  Stroker.thisIsHome();
+  delay(2000);
+
+  Stroker.setPattern(0, false);
+  Stroker.setDepth(150.0, false);
+  Stroker.setStroke(100.0, false);
+  Stroker.setSpeed(STROKES_PER_MINUTE, false);
+
+  xTaskCreatePinnedToCore(sliderStorm, "Slider", 4096, NULL, 2, NULL, 0);
+
+  Serial.printf("Parameters: %.0f strokes/min, one update every %d ms\n", STROKES_PER_MINUTE, SLIDER_PERIOD_MS);
+  Serial.printf("%-8s %8s %8s %8s %8s %8s %8s %12s %12s\n", "Run", "updates", "applied", "requests", 
+    "replans", "moves", "missed", "gap p99 [us]", "gap max [us]");
+
+  updateCounters counters;
+  motionStats quiet = runPattern(false, false, counters);
+  printResult("quiet", quiet, counters);
+  motionStats storm = runPattern(true, false, counters);
+  printResult("storm", storm, counters);
+  updateCounters replanCounters;
+  motionStats replan = runPattern(true, true, replanCounters);
+  printResult("applyNow", replan, replanCounters);
+
+  Serial.printf("Missed motion cycles under slider storm: %s\n", 
+    ((storm.mutexMisses == 0) && (replan.mutexMisses == 0)) ? "PASS" : "FAIL");
+  Serial.printf("Re-plans limited to one per %d ms: %s\n", REPLAN_INTERVAL_MS,
+    (replanCounters.replans <= RUN_MS / REPLAN_INTERVAL_MS + 1) ? "PASS" : "FAIL");
+}
+
+void loop() {
+  delay(1000);
+}
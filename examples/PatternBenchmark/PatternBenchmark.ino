@@ -0,0 +1,236 @@
+/**
+ *   Pattern Benchmark for the StrokeEngine
+ *   Drives every pattern and the streaming buffer through millions of 
+ *   nextTarget() calls with randomized parameter updates and reports the compute 
+ *   cost per stroke. Use it to check a custom pattern against the per-stroke 
+ *   compute budget before it ships. Also compares virtual and static dispatch
+ *   and the fixed point pattern math with its float reference.
+ *   No servo or stepper needs to be connected.
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <Arduino.h>
+#include <StrokeEngine.h>
+
+#define CALLS_PER_PATTERN   1000000   // nextTarget() calls per pattern
+#define CALLS_PER_UPDATE    1000      // A random set-function is called every n strokes
+#define COMPUTE_BUDGET_US   100       // Worst case a single nextTarget() may take in µs
+
+// Machine used to derive realistic parameters in steps
+#define STEP_PER_MM         50.0
+#define MAX_SPEED_MM        900.0
+#define MAX_ACCEL_MM        10000.0
+#define TRAVEL_MM           150.0
+
+typedef struct {
+  uint64_t cycles;            // Cycles spent inside nextTarget()
+  uint32_t worstCycles;       // Slowest single nextTarget()
+  uint64_t updateCycles;      // Cycles spent inside set-functions
+  uint32_t updates;           // Number of set-functions called
+} benchmarkResult;
+
+static inline float cyclesToNs(float cycles) {
+  return cycles * 1000.0 / getCpuFrequencyMhz();
+}
+
+// Calls a random set-function with a random, but valid value
+void randomUpdate(Pattern *pattern) {
+  int maxStep = TRAVEL_MM * STEP_PER_MM;
+  switch (random(3)) {
+    case 0:
+      // 0.5 to 600 strokes per minute
+      pattern->setTimeOfStroke(60.0 / (random(5, 6000) / 10.0));
+      break;
+    case 1:
+      pattern->setStroke(random(0, maxStep));
+      break;
+    default:
+      pattern->setSensation(random(-100, 101));
+      break;
+  }
+}
+
+void resetPattern(Pattern *pattern) {
+  int maxStep = TRAVEL_MM * STEP_PER_MM;
+  pattern->setSpeedLimit(MAX_SPEED_MM * STEP_PER_MM, MAX_ACCEL_MM * STEP_PER_MM, STEP_PER_MM);
+  pattern->setTimeOfStroke(1.0);
+  pattern->setDepth(maxStep);
+  pattern->setStroke(maxStep / 3);
+  pattern->setSensation(0.0);
+}
+
+benchmarkResult benchmarkPattern(Pattern *pattern) {
+  benchmarkResult result = {0, 0, 0, 0};
+  randomSeed(42);
+  resetPattern(pattern);
+
+  for (unsigned int index = 0; index < CALLS_PER_PATTERN; index++) {
+    if ((index % CALLS_PER_UPDATE) == 0) {
+      uint32_t start = ESP.getCycleCount();
+      randomUpdate(pattern);
+      result.updateCycles += ESP.getCycleCount() - start;
+      result.updates++;
+    }
+
+    uint32_t start = ESP.getCycleCount();
+    pattern->nextTarget(index);
+    uint32_t cycles = ESP.getCycleCount() - start;
+
+    result.cycles += cycles;
+    if (cycles > result.worstCycles) {
+      result.worstCycles = cycles;
+    }
+
+    // Keep the watchdog happy
+    if ((index % 100000) == 0) {
+      yield();
+    }
+  }
+
+  return result;
+}
+
+// Compares the cost of nextTarget() called through the vtable with the static
+// dispatch the stroking task uses. No parameter updates, just the call.
+#define DISPATCH_CALLS      100000
+
+void compareDispatch(Pattern *pattern) {
+  resetPattern(pattern);
+
+  uint32_t start = ESP.getCycleCount();
+  for (unsigned int index = 0; index < DISPATCH_CALLS; index++) {
+    pattern->nextTarget(index);
+  }
+  uint32_t virtualCycles = ESP.getCycleCount() - start;
+
+  start = ESP.getCycleCount();
+  for (unsigned int index = 0; index < DISPATCH_CALLS; index++) {
+    dispatchNextTarget(pattern, index);
+  }
+  uint32_t staticCycles = ESP.getCycleCount() - start;
+
+  float virtualNs = cyclesToNs(float(virtualCycles) / DISPATCH_CALLS);
+  float staticNs = cyclesToNs(float(staticCycles) / DISPATCH_CALLS);
+  Serial.printf("%-22s %12.1f %12.1f %10.2f\n", pattern->getName(), virtualNs, staticNs, virtualNs / staticNs);
+  yield();
+}
+
+// Streams points into LivePosition and consumes them like the streaming task does.
+benchmarkResult benchmarkLivePosition() {
+  benchmarkResult result = {0, 0, 0, 0};
+  randomSeed(42);
+  resetPattern(livePosition);
+
+  for (unsigned int index = 0; index < CALLS_PER_PATTERN; index++) {
+    uint32_t start = ESP.getCycleCount();
+    livePosition->addPosition(random(0, 101), random(10, 1000));
+    result.updateCycles += ESP.getCycleCount() - start;
+    result.updates++;
+
+    start = ESP.getCycleCount();
+    livePosition->nextTarget(index);
+    uint32_t cycles = ESP.getCycleCount() - start;
+
+    result.cycles += cycles;
+    if (cycles > result.worstCycles) {
+      result.worstCycles = cycles;
+    }
+
+    if ((index % 100000) == 0) {
+      yield();
+    }
+  }
+
+  return result;
+}
+
+// Compares the speed of the fixed point TrapezoidProfile against the former float / 
+// double pattern math. Stroke time and distance are drawn at random, the profile is 
+// precomputed outside of the timed section like a set-function does. The deviation
+// is checked by FixedPointTest of the host simulation.
+#define PROFILE_SAMPLES     1000
+#define PROFILE_CALLS       100
+
+void compareProfileMath() {
+  uint64_t floatCycles = 0;
+  uint64_t fixedCycles = 0;
+  volatile int sink = 0;
+  randomSeed(42);
+
+  for (int sample = 0; sample < PROFILE_SAMPLES; sample++) {
+    // half stroke time from 0.05s to 10s and up to the full travel
+    float timeOfStroke = random(50, 10000) / 1000.0;
+    int stroke = random(100, TRAVEL_MM * STEP_PER_MM);
+    TrapezoidProfile profile;
+    profile.setTime(timeOfStroke);
+
+    int floatSpeed = 0;
+    int floatAcceleration = 0;
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < PROFILE_CALLS; i++) {
+      floatSpeed = int(1.5 * stroke/timeOfStroke);
+      floatAcceleration = int(3.0 * floatSpeed/timeOfStroke);
+      sink = floatAcceleration;
+    }
+    floatCycles += ESP.getCycleCount() - start;
+
+    int fixedSpeed = 0;
+    int fixedAcceleration = 0;
+    start = ESP.getCycleCount();
+    for (int i = 0; i < PROFILE_CALLS; i++) {
+      fixedSpeed = profile.speed(stroke);
+      fixedAcceleration = profile.acceleration(fixedSpeed);
+      sink = fixedAcceleration;
+    }
+    fixedCycles += ESP.getCycleCount() - start;
+  }
+
+  float floatNs = cyclesToNs(float(floatCycles) / (PROFILE_SAMPLES * PROFILE_CALLS));
+  float fixedNs = cyclesToNs(float(fixedCycles) / (PROFILE_SAMPLES * PROFILE_CALLS));
+  Serial.printf("Trapezoid math: float %.1f ns, fixed point %.1f ns, speedup %.1fx\n",
+    floatNs, fixedNs, floatNs / fixedNs);
+}
+
+void printResult(const char *name, benchmarkResult result) {
+  float nsPerCall = cyclesToNs(float(result.cycles) / CALLS_PER_PATTERN);
+  float worstUs = cyclesToNs(result.worstCycles) / 1000.0;
+  float nsPerUpdate = (result.updates > 0) ? cyclesToNs(float(result.updateCycles) / result.updates) : 0.0;
+
+  Serial.printf("%-22s %10.1f %12.2f %14.1f %s\n", name, nsPerCall, worstUs, nsPerUpdate,
+    (worstUs > COMPUTE_BUDGET_US) ? "OVER BUDGET" : "ok");
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Serial.printf("Pattern benchmark: %d calls per pattern, random update every %d strokes\n",
+    CALLS_PER_PATTERN, CALLS_PER_UPDATE);
+  Serial.printf("%-22s %10s %12s %14s\n", "Pattern", "ns/call", "worst [us]", "ns/update");
+
+  for (unsigned int i = 0; i < PatternRegistry::size(); i++) {
+    printResult(PatternRegistry::get(i)->getName(), benchmarkPattern(PatternRegistry::get(i)));
+  }
+
+  // Streaming, update column is the cost of addPosition()
+  printResult("Streaming", benchmarkLivePosition());
+
+  // Virtual against static dispatch of nextTarget()
+  Serial.println();
+  Serial.printf("%-22s %12s %12s %10s\n", "Dispatch", "virtual [ns]", "static [ns]", "speedup");
+  for (unsigned int i = 0; i < PatternRegistry::size(); i++) {
+    compareDispatch(PatternRegistry::get(i));
+  }
+
+  // Fixed point against float pattern math
+  Serial.println();
+  compareProfileMath();
+}
+
+void loop() {
+  delay(1000);
+}
@@ -0,0 +1,140 @@
+/**
+ *   Streaming Contention Benchmark for the StrokeEngine
+ *   A producer task on core 0 feeds points into the streaming buffer while a
+ *   consumer task on core 1 executes them like the streaming task does. The
+ *   run is repeated with the former mutex protected ingest and with the
+ *   lock-free ingest. Reports how long the producer and the consumer had to
+ *   wait for each other. No servo or stepper needs to be connected.
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <Arduino.h>
+#include <StrokeEngine.h>
+
+#define POINTS_PER_RUN      200000    // Points streamed per run
+#define POINTS_PER_BATCH    4         // Points appended with a single call
+#define CONSUMER_WORK_US    20        // Simulated motion compute while holding the mutex
+
+typedef struct {
+  uint32_t worstProducerUs;   // Slowest append of a batch
+  uint64_t producerUs;        // Time spent appending
+  uint32_t worstConsumerUs;   // Slowest consumer iteration
+  uint32_t consumed;          // Points executed
+  uint32_t dropped;           // Points rejected by a full buffer
+} contentionResult;
+
+static LivePosition stream;
+static SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+static volatile bool useMutex = true;
+static volatile bool producerDone = false;
+static volatile bool consumerDone = false;
+static contentionResult result;
+
+void producerTask(void *parameter) {
+  Movement batch[POINTS_PER_BATCH];
+  uint32_t sent = 0;
+
+  while (sent < POINTS_PER_RUN) {
+    for (int i = 0; i < POINTS_PER_BATCH; i++) {
+      batch[i] = Movement((sent + i) % 101, 20);
+    }
+
+    uint32_t start = micros();
+    size_t accepted = 0;
+    if (useMutex) {
+      // Former ingest path: every append takes the pattern mutex
+      if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
+        accepted = stream.addPositions(batch, POINTS_PER_BATCH);
+        xSemaphoreGive(mutex);
+      }
+    } else {
+      accepted = stream.addPositions(batch, POINTS_PER_BATCH);
+    }
+    uint32_t elapsed = micros() - start;
+
+    result.producerUs += elapsed;
+    if (elapsed > result.worstProducerUs) {
+      result.worstProducerUs = elapsed;
+    }
+    result.dropped += POINTS_PER_BATCH - accepted;
+    sent += POINTS_PER_BATCH;
+
+    // Let the consumer drain the buffer
+    if (accepted < POINTS_PER_BATCH) {
+      vTaskDelay(1);
+    }
+  }
+
+  producerDone = true;
+  vTaskDelete(NULL);
+}
+
+void consumerTask(void *parameter) {
+  int index = 0;
+
+  // Run until every point was either executed or dropped
+  while (!producerDone || (result.consumed + result.dropped < POINTS_PER_RUN)) {
+    uint32_t start = micros();
+
+    // The streaming task holds the mutex while it computes and issues a move
+    if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
+      if (!stream.nextTarget(++index).skip) {
+        result.consumed++;
+      } else {
+        index--;
+      }
+      delayMicroseconds(CONSUMER_WORK_US);
+      xSemaphoreGive(mutex);
+    }
+
+    uint32_t elapsed = micros() - start;
+    if (elapsed > result.worstConsumerUs) {
+      result.worstConsumerUs = elapsed;
+    }
+    taskYIELD();
+  }
+
+  consumerDone = true;
+  vTaskDelete(NULL);
+}
+
+void runContention(bool withMutex) {
+  result = {0, 0, 0, 0, 0};
+  useMutex = withMutex;
+  producerDone = false;
+  consumerDone = false;
+  stream.setDepth(1000);
+  stream.setStroke(1000);
+  stream.clear();
+
+  xTaskCreatePinnedToCore(consumerTask, "Consumer", 4096, NULL, 24, NULL, 1);
+  xTaskCreatePinnedToCore(producerTask, "Producer", 4096, NULL, 5, NULL, 0);
+
+  while (!consumerDone) {
+    delay(100);
+  }
+
+  Serial.printf("%-10s %14.2f %14u %14u %10u %10u\n", withMutex ? "mutex" : "lock-free",
+    float(result.producerUs) / (POINTS_PER_RUN / POINTS_PER_BATCH), unsigned(result.worstProducerUs),
+    unsigned(result.worstConsumerUs), unsigned(result.consumed), unsigned(result.dropped));
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Serial.printf("Streaming contention: %d points in batches of %d\n", POINTS_PER_RUN, POINTS_PER_BATCH);
+  Serial.printf("%-10s %14s %14s %14s %10s %10s\n", "Ingest", "append [us]", "worst [us]",
+    "consumer [us]", "consumed", "dropped");
+
+  runContention(true);
+  runContention(false);
+}
+
+void loop() {
+  delay(1000);
+}
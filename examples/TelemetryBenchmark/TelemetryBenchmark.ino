@@ -0,0 +1,137 @@
+/**
+ *   Telemetry Benchmark for the StrokeEngine
+ *   Runs a pattern twice, once with a consumer reading telemetry as fast as
+ *   it comes and once with a consumer much slower than the strokes, like a
+ *   congested WebSocket or MQTT connection. The timestamps of the telemetry
+ *   records show when the motion task commanded each stroke. Reports the
+ *   worst deviation of the stroke intervals from the nominal interval and
+ *   the number of dropped records. A slow consumer must only cause drops,
+ *   never late strokes. No servo or stepper needs to be connected.
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <Arduino.h>
+#include <StrokeEngine.h>
+
+#define RUN_MS              20000     // Duration of each run
+#define STROKES_PER_MINUTE  120.0     // Each move takes half of 60 / STROKES_PER_MINUTE seconds
+#define SLOW_CONSUMER_MS    1000      // Time the slow consumer spends per record
+#define TOLERANCE_US        2000      // Allowed difference of the worst deviation between both runs
+
+static motorProperties servoMotor {
+  .maxSpeed = 2000.0,
+  .maxAcceleration = 100000.0,
+  .stepsPerMillimeter = 50.0,
+  .invertDirection = false,
+  .enableActiveLow = true,
+  .stepPin = 4,
+  .directionPin = 16,
+  .enablePin = 17
+};
+
+static machineGeometry strokingMachine = {
+  .physicalTravel = 160.0,
+  .keepoutBoundary = 5.0
+};
+
+typedef struct {
+  uint32_t records;           // Records read
+  uint32_t intervals;         // Intervals between consecutive strokes measured
+  uint32_t worstDeviationUs;  // Worst deviation of an interval from the nominal one
+  unsigned long dropped;      // Records dropped during the run
+} telemetryResult;
+
+StrokeEngine Stroker;
+
+void evaluate(const telemetryRecord &record, telemetryRecord &previous, bool &hasPrevious, telemetryResult &result) {
+  const uint32_t nominalUs = uint32_t(0.5e6 * 60.0 / STROKES_PER_MINUTE);
+
+  // Only pattern moves are timed by the motion task
+  if (record.pattern == TELEMETRY_NO_PATTERN) {
+    return;
+  }
+  result.records++;
+
+  // Records missing in between were dropped, the interval is unknown
+  if (hasPrevious && (record.index == previous.index + 1)) {
+    uint32_t interval = record.timestamp - previous.timestamp;
+    uint32_t deviation = (interval > nominalUs) ? interval - nominalUs : nominalUs - interval;
+    result.intervals++;
+    if (deviation > result.worstDeviationUs) {
+      result.worstDeviationUs = deviation;
+    }
+  }
+  previous = record;
+  hasPrevious = true;
+}
+
+telemetryResult runPattern(uint32_t consumerMs) {
+  telemetryResult result = {0, 0, 0, 0};
+  telemetryRecord record, previous;
+  bool hasPrevious = false;
+
+  // Discard records of earlier moves
+  while (Stroker.readTelemetry(record));
+  unsigned long droppedBefore = Stroker.getTelemetryDropCount();
+
+  Stroker.startPattern();
+  uint32_t start = millis();
+  while (millis() - start < RUN_MS) {
+    if (Stroker.readTelemetry(record)) {
+      evaluate(record, previous, hasPrevious, result);
+
+      // A slow publisher holds on to each record
+      delay(consumerMs);
+    } else {
+      delay(1);
+    }
+  }
+  Stroker.stopMotion();
+  Stroker.waitForStop();
+
+  // Records still queued were commanded in time, they only were read late
+  while (Stroker.readTelemetry(record)) {
+    evaluate(record, previous, hasPrevious, result);
+  }
+  result.dropped = Stroker.getTelemetryDropCount() - droppedBefore;
+  return result;
+}
+
+void printResult(const char *name, const telemetryResult &result) {
+  Serial.printf("%-10s %10u %10u %14u %10lu\n", name, unsigned(result.records), unsigned(result.intervals),
+    unsigned(result.worstDeviationUs), result.dropped);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Stroker.begin(&strokingMachine, &servoMotor);
+  Stroker.thisIsHome();
+  delay(2000);
+
+  Stroker.setPattern(0, false);
+  Stroker.setDepth(150.0, false);
+  Stroker.setStroke(100.0, false);
+  Stroker.setSpeed(STROKES_PER_MINUTE, false);
+
+  Serial.printf("Telemetry: %.0f strokes/min, slow consumer %d ms per record, buffer %d records\n",
+    STROKES_PER_MINUTE, SLOW_CONSUMER_MS, TELEMETRY_QUEUE_DEPTH);
+  Serial.printf("%-10s %10s %10s %14s %10s\n", "Consumer", "records", "intervals", "deviation [us]", "dropped");
+
+  telemetryResult fast = runPattern(0);
+  printResult("fast", fast);
+  telemetryResult slow = runPattern(SLOW_CONSUMER_MS);
+  printResult("slow", slow);
+
+  bool timingUnaffected = slow.worstDeviationUs <= fast.worstDeviationUs + TOLERANCE_US;
+  Serial.printf("Motion timing with slow consumer: %s\n", timingUnaffected ? "PASS" : "FAIL");
+}
+
+void loop() {
+  delay(1000);
+}
@@ -0,0 +1,319 @@
+/**
+ *   Funscript Compiler for the StrokeEngine
+ *   Compiles funscripts or T-code into a pattern file of precomputed moves,
+ *   planned and clipped against the limits of a machine. Reports every move
+ *   the machine can't do in time before the script is ever played.
+ *
+ *   Build:  g++ -std=c++11 -O2 -o funscript_compiler funscript_compiler.cpp
+ *   Usage:  funscript_compiler -t <travel mm> -v <max speed mm/s> -a <max acceleration mm/s²>
+ *                              -o <output file> <script> [<script> ...]
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "../../src/MotionPlanner.h"
+#include "../../src/PatternFileFormat.h"
+
+typedef struct {
+  long time;          // Timestamp of the action in ms
+  float position;     // Position from 0.0 (out) to 1.0 (in)
+} action;
+
+typedef struct {
+  std::string name;
+  std::vector<plannedMove> moves;
+} compiledScript;
+
+static std::string readFile(const char *path) {
+  std::string content;
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return content;
+  }
+  char buffer[4096];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    content.append(buffer, length);
+  }
+  fclose(file);
+  return content;
+}
+
+// Reads the number following a "key": inside of a JSON object
+static bool readJsonNumber(const std::string &object, const char *key, double &value) {
+  std::string pattern = std::string("\"") + key + "\"";
+  size_t position = object.find(pattern);
+  if (position == std::string::npos) {
+    return false;
+  }
+  position = object.find(':', position + pattern.size());
+  if (position == std::string::npos) {
+    return false;
+  }
+  char *end = NULL;
+  value = strtod(object.c_str() + position + 1, &end);
+  return end != object.c_str() + position + 1;
+}
+
+// Funscript: {"actions": [{"at": 100, "pos": 50}, ...]}, pos from 0 to 100
+static bool parseFunscript(const std::string &content, std::vector<action> &actions) {
+  size_t position = content.find("\"actions\"");
+  if (position == std::string::npos) {
+    return false;
+  }
+  size_t end = content.find(']', position);
+
+  while (true) {
+    size_t open = content.find('{', position);
+    if ((open == std::string::npos) || (open > end)) {
+      break;
+    }
+    size_t close = content.find('}', open);
+    if (close == std::string::npos) {
+      return false;
+    }
+
+    std::string object = content.substr(open, close - open + 1);
+    double at, pos;
+    if (!readJsonNumber(object, "at", at) || !readJsonNumber(object, "pos", pos)) {
+      return false;
+    }
+    action a = {long(at), float(pos / 100.0)};
+    actions.push_back(a);
+    position = close + 1;
+  }
+  return !actions.empty();
+}
+
+// T-code: one linear move of axis L0 per line, e.g. "L0850I500" moves to 0.850 within 500ms
+static bool parseTCode(const std::string &content, std::vector<action> &actions) {
+  long time = 0;
+  size_t position = 0;
+
+  while ((position = content.find("L0", position)) != std::string::npos) {
+    position += 2;
+    size_t digits = position;
+    while ((digits < content.size()) && (content[digits] >= '0') && (content[digits] <= '9')) {
+      digits++;
+    }
+    if (digits == position) {
+      continue;
+    }
+
+    // The digits are the decimal places of a fraction
+    std::string value = content.substr(position, digits - position);
+    float fraction = float(atof(("0." + value).c_str()));
+
+    long interval = 0;
+    if ((digits < content.size()) && ((content[digits] == 'I') || (content[digits] == 'i'))) {
+      interval = strtol(content.c_str() + digits + 1, NULL, 10);
+    }
+
+    time += interval;
+    action a = {time, fraction};
+    actions.push_back(a);
+    position = digits;
+  }
+  return !actions.empty();
+}
+
+static inline uint32_t toFixed(float value) {
+  return uint32_t(value * 65536.0f + 0.5f);
+}
+
+#define MAX_MOVE_DURATION   65535     // Longest duration of a plannedMove in ms
+
+// Adds a move from one position to another. Moves longer than a plannedMove can hold, 
+// like long pauses, are split into equal parts along the way. Returns the number of parts.
+static unsigned int addMove(compiledScript &script, float from, float to, const plannedProfile &profile,
+  float speedLimit, float accelerationLimit) {
+  unsigned int parts = (unsigned int)ceilf(profile.time * 1000.0f / MAX_MOVE_DURATION);
+  parts = (parts > 1) ? parts : 1;
+
+  for (unsigned int part = 1; part <= parts; part++) {
+    // A single part keeps the profile as planned, it may be clipped
+    plannedProfile partProfile = profile;
+    if (parts > 1) {
+      partProfile = planTrapezoid(fabsf(to - from) / parts, profile.time / parts, speedLimit, accelerationLimit);
+    }
+    float position = from + (to - from) * part / parts;
+
+    plannedMove move;
+    move.position = uint16_t(fminf(fmaxf(position, 0.0f), 1.0f) * 10000.0f + 0.5f);
+    move.duration = uint16_t(fminf(partProfile.time * 1000.0f + 0.5f, float(MAX_MOVE_DURATION)));
+    move.speed = toFixed(partProfile.speed);
+    move.acceleration = toFixed(partProfile.acceleration);
+    script.moves.push_back(move);
+  }
+  return parts;
+}
+
+// Plans all moves of a script in units of the stroke. Reports clipping to stdout.
+static bool compile(const char *path, float travel, float maxSpeed, float maxAcceleration, compiledScript &script) {
+  std::string content = readFile(path);
+  if (content.empty()) {
+    fprintf(stderr, "%s: can't read file\n", path);
+    return false;
+  }
+
+  std::vector<action> actions;
+  bool isJson = content.find("\"actions\"") != std::string::npos;
+  if (!(isJson ? parseFunscript(content, actions) : parseTCode(content, actions))) {
+    fprintf(stderr, "%s: no actions found\n", path);
+    return false;
+  }
+  if (actions.size() > 65535) {
+    fprintf(stderr, "%s: more than 65535 actions\n", path);
+    return false;
+  }
+
+  // Name of the entry is the file name without path and extension
+  std::string name = path;
+  size_t slash = name.find_last_of("/\\");
+  if (slash != std::string::npos) {
+    name = name.substr(slash + 1);
+  }
+  name = name.substr(0, name.find('.'));
+  script.name = name.substr(0, PATTERN_FILE_NAME_LEN - 1);
+
+  // Limits of a full stroke expressed in strokes. Smaller strokes stay within them.
+  float speedLimit = maxSpeed / travel;
+  float accelerationLimit = maxAcceleration / travel;
+
+  unsigned int clipped = 0;
+  float lateness = 0.0;
+  float worstLateness = 0.0;
+
+  for (size_t i = 0; i < actions.size(); i++) {
+    // The script loops, so the first action is approached from the last one
+    const action &from = actions[(i + actions.size() - 1) % actions.size()];
+    const action &to = actions[i];
+    float requested = (i == 0) ? to.time / 1000.0f : (to.time - from.time) / 1000.0f;
+    float distance = fabsf(to.position - from.position);
+
+    // A first action at 0 is the start position. Without a time given, the axis
+    // gets there at the limits, which is neither clipping nor a delay.
+    if ((i == 0) && (requested <= 0.0f)) {
+      plannedProfile profile = planTrapezoid(distance, 0.0f, speedLimit, accelerationLimit);
+      addMove(script, from.position, to.position, profile, speedLimit, accelerationLimit);
+      continue;
+    }
+
+    // Catch up on delays of previous moves, as far as the limits allow
+    float available = requested - lateness;
+    plannedProfile profile = planTrapezoid(distance, available, speedLimit, accelerationLimit);
+    lateness = fmaxf(profile.time - requested + lateness, 0.0f);
+
+    if (profile.clipped) {
+      clipped++;
+      worstLateness = fmaxf(worstLateness, lateness);
+      printf("%s: clipped move %u at %.3fs to %.0f%%, %.0fms late\n", script.name.c_str(), unsigned(i),
+        to.time / 1000.0f, to.position * 100.0f, lateness * 1000.0f);
+    }
+
+    unsigned int parts = addMove(script, from.position, to.position, profile, speedLimit, accelerationLimit);
+    if (parts > 1) {
+      printf("%s: split move %u at %.3fs of %.1fs into %u moves\n", script.name.c_str(), unsigned(i),
+        to.time / 1000.0f, profile.time, parts);
+    }
+  }
+
+  if (script.moves.size() > 65535) {
+    fprintf(stderr, "%s: more than 65535 moves\n", path);
+    return false;
+  }
+
+  printf("%s: %u moves, %.1fs, %u clipped, worst delay %.0fms\n", script.name.c_str(), unsigned(script.moves.size()),
+    actions.back().time / 1000.0f, clipped, worstLateness * 1000.0f);
+  return true;
+}
+
+static bool writePatternFile(const char *path, const std::vector<compiledScript> &scripts) {
+  std::vector<uint8_t> file(sizeof(patternFileHeader) + scripts.size() * sizeof(patternFileEntry), 0);
+
+  for (size_t i = 0; i < scripts.size(); i++) {
+    // Data is 4 byte aligned, plannedMove is a multiple of 4 bytes
+    patternFileEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.name, scripts[i].name.c_str(), PATTERN_FILE_NAME_LEN - 1);
+    entry.type = PATTERN_FILE_MOTION;
+    entry.count = uint16_t(scripts[i].moves.size());
+    entry.offset = uint32_t(file.size());
+    memcpy(&file[sizeof(patternFileHeader) + i * sizeof(patternFileEntry)], &entry, sizeof(entry));
+
+    const uint8_t *data = (const uint8_t *)scripts[i].moves.data();
+    file.insert(file.end(), data, data + scripts[i].moves.size() * sizeof(plannedMove));
+  }
+
+  patternFileHeader header;
+  memcpy(header.magic, PATTERN_FILE_MAGIC, 4);
+  header.version = PATTERN_FILE_VERSION;
+  header.entries = uint16_t(scripts.size());
+  header.size = uint32_t(file.size());
+  header.reserved = 0;
+  memcpy(&file[0], &header, sizeof(header));
+
+  FILE *output = fopen(path, "wb");
+  if (output == NULL) {
+    fprintf(stderr, "%s: can't write file\n", path);
+    return false;
+  }
+  bool written = fwrite(file.data(), 1, file.size(), output) == file.size();
+  fclose(output);
+  return written;
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: funscript_compiler -t <travel mm> -v <max speed mm/s> -a <max acceleration mm/s^2>\n"
+                  "                          -o <output file> <script> [<script> ...]\n");
+}
+
+int main(int argc, char *argv[]) {
+  float travel = 0.0;
+  float maxSpeed = 0.0;
+  float maxAcceleration = 0.0;
+  const char *output = NULL;
+  std::vector<const char *> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc)) {
+      travel = atof(argv[++i]);
+    } else if ((strcmp(argv[i], "-v") == 0) && (i + 1 < argc)) {
+      maxSpeed = atof(argv[++i]);
+    } else if ((strcmp(argv[i], "-a") == 0) && (i + 1 < argc)) {
+      maxAcceleration = atof(argv[++i]);
+    } else if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc)) {
+      output = argv[++i];
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+
+  if ((travel <= 0.0) || (maxSpeed <= 0.0) || (maxAcceleration <= 0.0) || (output == NULL) || inputs.empty()) {
+    usage();
+    return 1;
+  }
+  if (inputs.size() > 65535) {
+    fprintf(stderr, "Too many scripts\n");
+    return 1;
+  }
+
+  std::vector<compiledScript> scripts;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    compiledScript script;
+    if (!compile(inputs[i], travel, maxSpeed, maxAcceleration, script)) {
+      return 1;
+    }
+    scripts.push_back(script);
+  }
+
+  return writePatternFile(output, scripts) ? 0 : 1;
+}
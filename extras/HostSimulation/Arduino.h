@@ -0,0 +1,227 @@
+/**
+ *   Arduino and FreeRTOS shim for the host simulation of the StrokeEngine
+ *   Provides the small subset of the Arduino core and the FreeRTOS API the
+ *   library uses, so it compiles and runs on Linux against a VirtualStepper.
+ *   Time is simulated and only passes with hostAdvanceTime(), delay() or
+ *   vTaskDelay(). Tasks are created, but never run: StrokeEngineSimulation
+ *   calls the iterations of the motion tasks instead. Everything runs on a
+ *   single thread, so critical sections and mutexes never block.
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+#ifndef STROKEENGINE_HOST_SIMULATION
+  #error "The host simulation shim needs STROKEENGINE_HOST_SIMULATION defined"
+#endif
+
+/*################################### Time ####################################*/
+
+//! Simulated time since start in µs
+uint64_t hostTime();
+
+//! Advance the simulated time
+void hostAdvanceTime(uint64_t micros);
+
+inline unsigned long micros() { return (unsigned long)hostTime(); }
+inline unsigned long millis() { return (unsigned long)(hostTime() / 1000); }
+inline void delay(unsigned long ms) { hostAdvanceTime(uint64_t(ms) * 1000); }
+inline void delayMicroseconds(unsigned int us) { hostAdvanceTime(us); }
+
+/*################################## Arduino ##################################*/
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+#define PI              3.1415926535897932384626433832795
+#define HALF_PI         1.5707963267948966192313216916398
+#define TWO_PI          6.283185307179586476925286766559
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::min;
+using std::max;
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// No pins on the host: inputs read low, outputs go nowhere
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline int digitalRead(uint8_t pin) { return LOW; }
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+inline uint16_t analogRead(uint8_t pin) { return 0; }
+
+//! Just enough of the Arduino String class for the debug messages of the library
+class String {
+  public:
+    String(const char *str = "") : _str(str ? str : "") {}
+    String(const std::string &str) : _str(str) {}
+    explicit String(char c) : _str(1, c) {}
+    explicit String(int value) : _str(std::to_string(value)) {}
+    explicit String(unsigned int value) : _str(std::to_string(value)) {}
+    explicit String(long value) : _str(std::to_string(value)) {}
+    explicit String(unsigned long value) : _str(std::to_string(value)) {}
+    explicit String(float value, unsigned int decimals = 2) : _str(_format(value, decimals)) {}
+    explicit String(double value, unsigned int decimals = 2) : _str(_format(value, decimals)) {}
+
+    const char *c_str() const { return _str.c_str(); }
+    unsigned int length() const { return _str.length(); }
+    bool operator==(const String &other) const { return _str == other._str; }
+    bool operator!=(const String &other) const { return _str != other._str; }
+    String &operator+=(const String &other) { _str += other._str; return *this; }
+
+    friend String operator+(const String &a, const String &b) { return String(a._str + b._str); }
+    friend String operator+(const String &a, const char *b) { return String(a._str + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b._str); }
+
+  protected:
+    std::string _str;
+
+    static std::string _format(double value, unsigned int decimals) {
+      char buffer[64];
+      snprintf(buffer, sizeof(buffer), "%.*f", int(decimals), value);
+      return buffer;
+    }
+};
+
+//! Serial port writing to stdout
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud) {}
+    void print(const String &str) { fputs(str.c_str(), stdout); }
+    void print(const char *str) { fputs(str, stdout); }
+    void print(int value) { printf("%d", value); }
+    void print(unsigned int value) { printf("%u", value); }
+    void print(long value) { printf("%ld", value); }
+    void print(unsigned long value) { printf("%lu", value); }
+    void print(double value, int decimals = 2) { printf("%.*f", decimals, value); }
+    void println() { fputs("\n", stdout); }
+    template <typename T> void println(T value) { print(value); println(); }
+    void println(double value, int decimals) { print(value, decimals); println(); }
+
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+      va_list args;
+      va_start(args, format);
+      int length = vprintf(format, args);
+      va_end(args);
+      return length;
+    }
+};
+
+extern HardwareSerial Serial;
+
+/*################################## FreeRTOS #################################*/
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t EventBits_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define portMAX_DELAY           TickType_t(0xffffffff)
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       TickType_t(ms)
+
+//! A task that is never run. Keeps the notifications given to it.
+typedef struct {
+  const char *name;
+  uint32_t notifications;
+  bool suspended;
+} hostTask;
+
+typedef hostTask *TaskHandle_t;
+
+//! Mutex of a single thread, taking it fails only if it is taken already
+typedef struct {
+  bool taken;
+} hostSemaphore;
+
+typedef hostSemaphore *SemaphoreHandle_t;
+
+typedef struct {
+  EventBits_t bits;
+} hostEventGroup;
+
+typedef hostEventGroup *EventGroupHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth,
+  void *parameter, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+
+inline void vTaskDelete(TaskHandle_t task) {}
+inline void vTaskSuspend(TaskHandle_t task) { if (task) task->suspended = true; }
+inline void vTaskResume(TaskHandle_t task) { if (task) task->suspended = false; }
+inline void vTaskDelay(TickType_t ticks) { hostAdvanceTime(uint64_t(ticks) * portTICK_PERIOD_MS * 1000); }
+inline void xTaskNotifyGive(TaskHandle_t task) { if (task) task->notifications++; }
+
+// Only called by task functions, which never run on the host
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) { return 0; }
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new hostSemaphore{false}; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  if (semaphore->taken) {
+    return pdFALSE;
+  }
+  semaphore->taken = true;
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  semaphore->taken = false;
+  return pdTRUE;
+}
+
+inline EventGroupHandle_t xEventGroupCreate() { return new hostEventGroup{0}; }
+
+inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+  return group->bits |= bits;
+}
+
+inline EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+  EventBits_t before = group->bits;
+  group->bits &= ~bits;
+  return before;
+}
+
+// Nothing else can set the bits while waiting, so this returns right away
+inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+  BaseType_t clear, BaseType_t waitForAll, TickType_t ticks) {
+  EventBits_t before = group->bits;
+  bool satisfied = waitForAll ? ((before & bits) == bits) : ((before & bits) != 0);
+  if (satisfied && clear) {
+    group->bits &= ~bits;
+  }
+  return before;
+}
+
+typedef struct {
+  uint32_t owner;
+  uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0, 0 }
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
@@ -0,0 +1,32 @@
+/**
+ *   Arduino and FreeRTOS shim for the host simulation of the StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <Arduino.h>
+
+static uint64_t simulatedTime = 0;
+
+HardwareSerial Serial;
+
+uint64_t hostTime() {
+  return simulatedTime;
+}
+
+void hostAdvanceTime(uint64_t micros) {
+  simulatedTime += micros;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth,
+  void *parameter, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+  // The task is never run, StrokeEngineSimulation calls its iterations instead
+  TaskHandle_t task = new hostTask{name, 0, false};
+  if (handle != NULL) {
+    *handle = task;
+  }
+  return pdPASS;
+}
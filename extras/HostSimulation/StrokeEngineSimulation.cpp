@@ -0,0 +1,65 @@
+#include "StrokeEngineSimulation.h"
+
+// Simulation time step: one FreeRTOS tick
+#define SIMULATION_TICK_MICROS  (portTICK_PERIOD_MS * 1000)
+
+void StrokeEngineSimulation::run(uint32_t micros) {
+  uint64_t end = hostTime() + micros;
+  do {
+    _runTasks();
+
+    uint64_t step = min(uint64_t(SIMULATION_TICK_MICROS), end - hostTime());
+    _stepper.advance(uint32_t(step));
+    hostAdvanceTime(step);
+  } while (hostTime() < end);
+}
+
+bool StrokeEngineSimulation::runUntilStopped(uint32_t timeout) {
+  uint64_t end = hostTime() + timeout;
+  while (_state == STOPPING) {
+    if (hostTime() >= end) {
+      return false;
+    }
+    run(SIMULATION_TICK_MICROS);
+  }
+  return true;
+}
+
+void StrokeEngineSimulation::_runTasks() {
+  // Stopping task: completes the stop once the axis stands still
+  if ((_taskStoppingHandle != NULL) && (_taskStoppingHandle->notifications > 0)) {
+    if ((_stepper.isRunning() == false) || (_state != STOPPING)) {
+      _taskStoppingHandle->notifications = 0;
+      _completeStop();
+    }
+  }
+
+  _runMotionTask(_taskStrokingHandle, PATTERN, &StrokeEngineSimulation::_strokingCycle, _strokingWake);
+  _runMotionTask(_taskStreamingHandle, STREAMING, &StrokeEngineSimulation::_streamingCycle, _streamingWake);
+}
+
+void StrokeEngineSimulation::_runMotionTask(TaskHandle_t task, ServoState state, 
+  TickType_t (StrokeEngine::*cycle)(), uint64_t &wake) {
+  if ((task == NULL) || (task->suspended == true)) {
+    return;
+  }
+
+  // Sleeping until the timeout or a notification
+  if ((task->notifications == 0) && (hostTime() < wake)) {
+    return;
+  }
+  task->notifications = 0;
+
+  // The task suspends itself if not in its state, until it is resumed
+  if (_state != state) {
+#ifdef STROKEENGINE_STATS
+    _statsLastLoop = 0;
+    _statsMoving = false;
+#endif
+    vTaskSuspend(task);
+    return;
+  }
+
+  TickType_t ticks = (this->*cycle)();
+  wake = hostTime() + uint64_t(ticks) * SIMULATION_TICK_MICROS;
+}
@@ -0,0 +1,73 @@
+/**
+ *   Host Simulation of the StrokeEngine
+ *   Runs the StrokeEngine on Linux against a VirtualStepper in simulated time.
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <StrokeEngine.h>
+#include <VirtualStepper.h>
+
+/**************************************************************************/
+/*!
+  @class StrokeEngineSimulation
+  @brief  StrokeEngine driving a VirtualStepper in simulated time. The
+          FreeRTOS tasks of the StrokeEngine are never run on the host.
+          Instead run() advances time tick by tick and calls one iteration
+          of the stroking or streaming task whenever the task would wake up
+          on the ESP32: after the ticks the last iteration asked to sleep,
+          or right away after a notification, e.g. from a set-function with
+          applyNow. The stopping task completes a stop once the axis came to
+          a halt. All API functions can be called between two calls of run().
+          As the global step generator of the StrokeEngine is shared, only
+          one instance may be used at a time.
+*/
+/**************************************************************************/
+class StrokeEngineSimulation : public StrokeEngine {
+
+  public:
+    //! Constructor
+    /*!
+      @param timeStepMicros integration time step of the VirtualStepper in µs
+    */
+    StrokeEngineSimulation(uint32_t timeStepMicros = 10) : _stepper(timeStepMicros) {}
+
+    //! Initialize the StrokeEngine with the simulated stepper
+    /*!
+      @param physics pointer to the machine geometry
+      @param motor pointer to the motor properties. Step and enable pins are not used.
+    */
+    void begin(machineGeometry *physics, motorProperties *motor) {
+      StrokeEngine::begin(physics, motor, &_stepper);
+    }
+
+    //! Run the tasks and the stepper in simulated time
+    /*!
+      @param micros time in µs to run. Tasks that are due run first, so 
+                    run(0) only runs the tasks.
+    */
+    void run(uint32_t micros);
+
+    //! Run until the stopping task completed the stop
+    /*!
+      @param timeout longest time in µs to wait for
+      @return true if the engine stopped in time
+    */
+    bool runUntilStopped(uint32_t timeout = 10000000);
+
+    //! The simulated stepper
+    VirtualStepper &stepper() { return _stepper; }
+
+  protected:
+    VirtualStepper _stepper;
+    uint64_t _strokingWake = 0;         /*> Simulated time at which the stroking task wakes up */
+    uint64_t _streamingWake = 0;        /*> Simulated time at which the streaming task wakes up */
+    void _runTasks();
+    void _runMotionTask(TaskHandle_t task, ServoState state, TickType_t (StrokeEngine::*cycle)(), uint64_t &wake);
+};
@@ -0,0 +1,123 @@
+/**
+ *   Counts heap allocations while the patterns compute their strokes. Every
+ *   registered pattern runs through a million nextTarget() calls with a random
+ *   set-function every 1000 strokes, like the PatternBenchmark example does on
+ *   target. Then a million points are streamed through LivePosition and 
+ *   consumed like the streaming task does. None of it may allocate, and the 
+ *   heap in use must not change.
+ */
+
+#include "HostTest.h"
+#include <malloc.h>
+
+#define CALLS_PER_PATTERN   1000000   // nextTarget() calls per pattern
+#define CALLS_PER_UPDATE    1000      // A random set-function is called every n strokes
+
+// All allocations end up in malloc(), including operator new
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+static unsigned long allocations = 0;
+static volatile int sink = 0;
+
+extern "C" void *malloc(size_t size) {
+  allocations++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  allocations++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+  allocations++;
+  return __libc_realloc(pointer, size);
+}
+
+static size_t heapInUse() {
+  return mallinfo2().uordblks;
+}
+
+static void resetPattern(Pattern *pattern, int maxStep) {
+  pattern->setSpeedLimit(int(testMotor.maxSpeed * testMotor.stepsPerMillimeter), 
+    int(testMotor.maxAcceleration * testMotor.stepsPerMillimeter), testMotor.stepsPerMillimeter);
+  pattern->setTimeOfStroke(1.0);
+  pattern->setDepth(maxStep);
+  pattern->setStroke(maxStep / 3);
+  pattern->setSensation(0.0);
+}
+
+// Calls a random set-function with a random, but valid value
+static void randomUpdate(Pattern *pattern, int maxStep) {
+  switch (rand() % 3) {
+    case 0:
+      // 0.5 to 600 strokes per minute
+      pattern->setTimeOfStroke(60.0 / ((5 + rand() % 5995) / 10.0));
+      break;
+    case 1:
+      pattern->setStroke(rand() % maxStep);
+      break;
+    default:
+      pattern->setSensation(rand() % 201 - 100);
+      break;
+  }
+}
+
+static void testPattern(Pattern *pattern, int maxStep) {
+  srand(42);
+  resetPattern(pattern, maxStep);
+
+  unsigned long allocationsBefore = allocations;
+  size_t heapBefore = heapInUse();
+  for (unsigned int index = 0; index < CALLS_PER_PATTERN; index++) {
+    if ((index % CALLS_PER_UPDATE) == 0) {
+      randomUpdate(pattern, maxStep);
+    }
+    // Use the result, so the call can't be optimized away
+    sink = dispatchNextTarget(pattern, index).stroke;
+  }
+  unsigned long count = allocations - allocationsBefore;
+  long heapDelta = long(heapInUse()) - long(heapBefore);
+
+  printf("%-24s allocations %6lu  heap %+6ld B\n", pattern->getName(), count, heapDelta);
+  CHECK(count == 0, "%s allocated %lu times", pattern->getName(), count);
+  CHECK(heapDelta == 0, "%s changed the heap by %ld bytes", pattern->getName(), heapDelta);
+}
+
+static void testStreaming(int maxStep) {
+  srand(42);
+  resetPattern(livePosition, maxStep);
+  livePosition->clear();
+
+  unsigned long allocationsBefore = allocations;
+  size_t heapBefore = heapInUse();
+  for (unsigned int index = 0; index < CALLS_PER_PATTERN; index++) {
+    livePosition->addPosition(rand() % 101, 10 + rand() % 990);
+    sink = livePosition->nextTarget(index).stroke;
+  }
+  unsigned long count = allocations - allocationsBefore;
+  long heapDelta = long(heapInUse()) - long(heapBefore);
+
+  printf("%-24s allocations %6lu  heap %+6ld B\n", "LivePosition", count, heapDelta);
+  CHECK(count == 0, "Streaming allocated %lu times", count);
+  CHECK(heapDelta == 0, "Streaming changed the heap by %ld bytes", heapDelta);
+}
+
+int main() {
+  // Make sure the allocations are actually counted
+  void *(*volatile allocate)(size_t) = malloc;
+  unsigned long probe = allocations;
+  free(allocate(16));
+  CHECK(allocations == probe + 1, "Allocations are not counted");
+
+  int maxStep = int(0.5 + (testMachine.physicalTravel - 2 * testMachine.keepoutBoundary) * testMotor.stepsPerMillimeter);
+
+  for (unsigned int i = 0; i < PatternRegistry::size(); i++) {
+    testPattern(PatternRegistry::get(i), maxStep);
+  }
+  testStreaming(maxStep);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+/**
+ *   Runs a keyframe pattern and a sequence moving in with several steps in
+ *   the same direction, once with TRAJECTORY_STOP and once with
+ *   TRAJECTORY_BLEND. Blending passes the steps without stopping, so a cycle
+ *   through the pattern must be shorter, while the reversals still reach
+ *   the full depth.
+ */
+
+#include "HostTest.h"
+#include <vector>
+
+#define RUN_MICROS          12000000    // Simulated time each pattern runs
+#define SAMPLE_MICROS       1000        // Interval of the position samples
+#define MIN_GAIN            0.05        // Blending must shorten a cycle at least by this share
+
+StrokeEngineSimulation engine;
+
+// Four steps in, one move out
+static const keyframe stepKeyframes[] = {
+  {25, 1, EASE_SMOOTH, 0, 0},
+  {50, 1, EASE_SMOOTH, 0, 0},
+  {75, 1, EASE_SMOOTH, 0, 0},
+  {100, 1, EASE_SMOOTH, 0, 0},
+  {0, 2, EASE_SMOOTH, 0, 0}
+};
+static KeyframePattern keyframeStop("Keyframes", stepKeyframes, 5);
+static KeyframePattern keyframeBlend("Keyframes blended", stepKeyframes, 5, TRAJECTORY_BLEND);
+REGISTER_PATTERN_INSTANCE(keyframeStop);
+REGISTER_PATTERN_INSTANCE(keyframeBlend);
+
+static const sequencePoint stepPoints[] = {
+  {2500, 150},
+  {5000, 150},
+  {7500, 150},
+  {10000, 150},
+  {0, 400}
+};
+static SequencePattern sequenceStop("Sequence", stepPoints, 5);
+static SequencePattern sequenceBlend("Sequence blended", stepPoints, 5, TRAJECTORY_BLEND);
+REGISTER_PATTERN_INSTANCE(sequenceStop);
+REGISTER_PATTERN_INSTANCE(sequenceBlend);
+
+// Average time of a cycle in ms, from the arrivals at depth
+static float cycleTime(unsigned int index) {
+  const char *name = PatternRegistry::get(index)->getName();
+  int depth = int(0.5 + 140.0 * testMotor.stepsPerMillimeter);
+  int maxStep = int(0.5 + (testMachine.physicalTravel - 2 * testMachine.keepoutBoundary) * testMotor.stepsPerMillimeter);
+
+  engine.setPattern(index, false);
+  engine.setDepth(140.0, false);
+  engine.setStroke(100.0, false);
+  engine.setSpeed(60.0, false);
+  CHECK(engine.startPattern(), "%s did not start", name);
+
+  std::vector<uint32_t> arrivals;
+  bool atDepth = false;
+  int lowest = maxStep;
+  int highest = 0;
+  for (uint32_t t = SAMPLE_MICROS; t <= RUN_MICROS; t += SAMPLE_MICROS) {
+    engine.run(SAMPLE_MICROS);
+    int position = engine.stepper().getCurrentPosition();
+    lowest = min(lowest, position);
+    highest = max(highest, position);
+    if ((position == depth) && !atDepth) {
+      arrivals.push_back(t / 1000);
+    }
+    atDepth = (position == depth);
+  }
+
+  engine.stopMotion();
+  CHECK(engine.runUntilStopped(), "%s did not stop", name);
+  CHECK((lowest >= 0) && (highest <= maxStep), "%s left the travel", name);
+  CHECK(arrivals.size() >= 3, "%s reached the depth %u times", name, unsigned(arrivals.size()));
+  if (arrivals.size() < 3) {
+    return 0.0;
+  }
+
+  // The first cycle starts from home
+  float cycle = float(arrivals.back() - arrivals[1]) / (arrivals.size() - 2);
+  printf("%-24s cycle %7.1f ms\n", name, cycle);
+  return cycle;
+}
+
+int main() {
+  beginAndHome(engine);
+
+  unsigned int first = PatternRegistry::size() - 4;
+  float keyframeStopCycle = cycleTime(first);
+  float keyframeBlendCycle = cycleTime(first + 1);
+  float sequenceStopCycle = cycleTime(first + 2);
+  float sequenceBlendCycle = cycleTime(first + 3);
+
+  CHECK(keyframeBlendCycle < keyframeStopCycle * (1.0 - MIN_GAIN), "Blended keyframes take %.1f ms instead of %.1f ms",
+    keyframeBlendCycle, keyframeStopCycle);
+  CHECK(sequenceBlendCycle < sequenceStopCycle * (1.0 - MIN_GAIN), "A blended sequence takes %.1f ms instead of %.1f ms",
+    sequenceBlendCycle, sequenceStopCycle);
+
+  return TEST_RESULT();
+}
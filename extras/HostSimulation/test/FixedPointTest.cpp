@@ -0,0 +1,86 @@
+/**
+ *   Compares the fixed point TrapezoidProfile of the built-in patterns against
+ *   the float math it replaced. Beyond the truncation of one step, speed and 
+ *   acceleration may deviate by the bounds documented in PatternMath.h: 1e-4
+ *   for moves shorter than 10s and 5e-4 for moves up to 60s. Acceleration is
+ *   compared for the same speed, so a truncated speed doesn't count twice.
+ *   Insist is compared against its former double precision math.
+ */
+
+#include "HostTest.h"
+
+#define SAMPLES             1000000
+
+// Relative deviation beyond the truncation of one step
+static double deviation(int fixed, int reference) {
+  return max(0.0, fabs(double(fixed) - reference) - 1.0) / max(1, abs(reference));
+}
+
+// Worst deviation of random moves up to maxTime, with a random acceleration share
+// if curved, else with the 1/3 accelerate, 1/3 coast, 1/3 decelerate profile
+static double worstDeviation(float minTime, float maxTime, bool curved) {
+  double worst = 0.0;
+  int maxStep = int(0.5 + (testMachine.physicalTravel - 2 * testMachine.keepoutBoundary) * testMotor.stepsPerMillimeter);
+  srand(42);
+
+  for (int i = 0; i < SAMPLES; i++) {
+    float time = minTime + (maxTime - minTime) * float(rand()) / RAND_MAX;
+    float share = curved ? 0.05f + 0.45f * float(rand()) / RAND_MAX : 1.0f / 3.0f;
+    int distance = 1 + rand() % maxStep;
+
+    TrapezoidProfile profile;
+    profile.setTime(time, share);
+    int speed = profile.speed(distance);
+    int acceleration = profile.acceleration(speed);
+
+    // The float math of the patterns before, acceleration derived from the same speed
+    int referenceSpeed = int(distance / ((1.0 - share) * time));
+    int referenceAcceleration = int(speed / (share * time));
+
+    worst = max(worst, max(deviation(speed, referenceSpeed), deviation(acceleration, referenceAcceleration)));
+  }
+  return worst;
+}
+
+int main() {
+  double shortMoves = worstDeviation(0.05, 10.0, false);
+  double shortCurved = worstDeviation(0.05, 10.0, true);
+  double longMoves = worstDeviation(10.0, 60.0, false);
+  double longCurved = worstDeviation(10.0, 60.0, true);
+
+  printf("Moves up to 10s: max deviation %.2e, with any acceleration share %.2e\n", shortMoves, shortCurved);
+  printf("Moves up to 60s: max deviation %.2e, with any acceleration share %.2e\n", longMoves, longCurved);
+  CHECK(max(shortMoves, shortCurved) <= 1e-4, "Moves up to 10s deviate by %.2e", max(shortMoves, shortCurved));
+  CHECK(max(longMoves, longCurved) <= 5e-4, "Moves up to 60s deviate by %.2e", max(longMoves, longCurved));
+
+  // Invalid times and shares stop the pattern instead of dividing by zero
+  TrapezoidProfile profile;
+  profile.setTime(0.0);
+  CHECK((profile.speed(1000) == 0) && (profile.acceleration(1000) == 0), "A time of 0 did not stop the move");
+  profile.setTime(1.0, 1.0);
+  CHECK((profile.speed(1000) == 0) && (profile.acceleration(1000) == 0), "A share of 1 did not stop the move");
+
+  // Insist against its former double math
+  Insist insist("Insist");
+  insist.setDepth(7000);
+  double worstInsist = 0.0;
+  for (int stroke = 500; stroke <= 7000; stroke += 500) {
+    for (float time = 0.1; time <= 10.0; time += 0.1) {
+      for (int sensation = -99; sensation <= 99; sensation += 3) {
+        insist.setStroke(stroke);
+        insist.setTimeOfStroke(time);
+        insist.setSensation(sensation);
+        motionParameter move = insist.nextTarget(0);
+
+        double halfTime = 0.5 * time;
+        int referenceSpeed = int(1.5 * stroke / halfTime);
+        int referenceAcceleration = int(3.0 * move.speed / (halfTime * ((100 - abs(sensation)) / 100.0f)));
+        worstInsist = max(worstInsist, max(deviation(move.speed, referenceSpeed), deviation(move.acceleration, referenceAcceleration)));
+      }
+    }
+  }
+  printf("Insist: max deviation %.2e\n", worstInsist);
+  CHECK(worstInsist <= 1e-4, "Insist deviates by %.2e", worstInsist);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,82 @@
+/**
+ *   Compares the single precision fscale() and mapSensationToFactor() with
+ *   the double precision pow() math they replaced, over curves from -10 to 10
+ *   and the full input range. Linear mappings skip the exponent, curved
+ *   mappings still call powf(). Errors are relative to the output range of
+ *   fscale() and to the factor of mapSensationToFactor().
+ */
+
+#include "HostTest.h"
+
+#define CURVE_STEPS         200         // Curves from -10 to 10 in steps of 0.1
+#define INPUT_STEPS         10000       // Inputs over the full range
+#define MAX_ERROR           1e-6        // Largest error allowed, single precision gives about 4e-7
+
+// fscale() as it was, in double precision
+static double referenceScale(double originalMin, double originalMax, double newBegin, double newEnd, double inputValue, double curve) {
+  curve = pow(10.0, -0.1 * max(-10.0, min(10.0, curve)));
+  inputValue = max(originalMin, min(originalMax, inputValue));
+  double normalized = pow((inputValue - originalMin) / (originalMax - originalMin), curve);
+  if (newEnd > newBegin) {
+    return newBegin + normalized * (newEnd - newBegin);
+  }
+  return newBegin - normalized * (newBegin - newEnd);
+}
+
+static double referenceFactor(double maximumFactor, double inputValue, double curve) {
+  if (inputValue == 0.0) {
+    return 1.0;
+  }
+  double factor = referenceScale(0.0, 100.0, 1.0, maximumFactor, fabs(inputValue), curve);
+  return (inputValue > 0.0) ? factor : 1.0 / factor;
+}
+
+// Largest error of fscale() mapping [0, 100] to [newBegin, newEnd]
+static double worstScaleError(float newBegin, float newEnd) {
+  double worst = 0.0;
+  for (int c = 0; c <= CURVE_STEPS; c++) {
+    float curve = -10.0f + 20.0f * c / CURVE_STEPS;
+    for (int i = 0; i <= INPUT_STEPS; i++) {
+      float input = 100.0f * i / INPUT_STEPS;
+      double error = fabs(fscale(0.0, 100.0, newBegin, newEnd, input, curve) - referenceScale(0.0, 100.0, newBegin, newEnd, input, curve));
+      worst = max(worst, error / fabs(newEnd - newBegin));
+    }
+  }
+  return worst;
+}
+
+// Largest relative error of mapSensationToFactor() over sensations from -100 to 100
+static double worstFactorError(float maximumFactor) {
+  double worst = 0.0;
+  for (int c = 0; c <= CURVE_STEPS; c++) {
+    float curve = -10.0f + 20.0f * c / CURVE_STEPS;
+    for (int i = -INPUT_STEPS; i <= INPUT_STEPS; i++) {
+      float sensation = 100.0f * i / INPUT_STEPS;
+      double reference = referenceFactor(maximumFactor, sensation, curve);
+      worst = max(worst, fabs(mapSensationToFactor(maximumFactor, sensation, curve) - reference) / reference);
+    }
+  }
+  return worst;
+}
+
+int main() {
+  double rising = worstScaleError(1.0, 3.0);
+  double falling = worstScaleError(1000.0, 10.0);
+  double factor = worstFactorError(3.0);
+  double largeFactor = worstFactorError(10.0);
+
+  printf("fscale() rising %.2e, falling %.2e, mapSensationToFactor() %.2e, with factor 10 %.2e\n",
+    rising, falling, factor, largeFactor);
+  CHECK(rising <= MAX_ERROR, "fscale() deviates by %.2e on a rising range", rising);
+  CHECK(falling <= MAX_ERROR, "fscale() deviates by %.2e on a falling range", falling);
+  CHECK(factor <= MAX_ERROR, "mapSensationToFactor() deviates by %.2e", factor);
+  CHECK(largeFactor <= MAX_ERROR, "mapSensationToFactor() deviates by %.2e with factor 10", largeFactor);
+
+  // Out of range inputs and curves are clamped like before
+  CHECK(fscale(0.0, 100.0, 1.0, 3.0, 150.0, 0.0) == 3.0f, "An input above the range is not clamped");
+  CHECK(fscale(0.0, 100.0, 1.0, 3.0, -50.0, 0.0) == 1.0f, "An input below the range is not clamped");
+  CHECK(fabs(fscale(0.0, 100.0, 1.0, 3.0, 50.0, 20.0) - fscale(0.0, 100.0, 1.0, 3.0, 50.0, 10.0)) < 1e-6,
+    "A curve above 10 is not clamped");
+
+  return TEST_RESULT();
+}
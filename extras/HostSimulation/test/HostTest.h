@@ -0,0 +1,54 @@
+/**
+ *   Test helpers of the host simulation of the StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <StrokeEngineSimulation.h>
+
+static int testFailures = 0;
+
+//! Report a failed condition with a printf style message and carry on
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+      printf("FAIL %s:%d: %s: ", __FILE__, __LINE__, #condition); \
+      printf(__VA_ARGS__); \
+      printf("\n"); \
+      testFailures++; \
+    } \
+  } while (0)
+
+//! Exit code of a test: 0 if all checks passed
+#define TEST_RESULT() (testFailures == 0 ? 0 : 1)
+
+// The machine all tests run on, 150 mm of usable travel
+static motorProperties testMotor {
+  .maxSpeed = 2000.0,
+  .maxAcceleration = 100000.0,
+  .stepsPerMillimeter = 50.0,
+  .invertDirection = false,
+  .enableActiveLow = true,
+  .stepPin = 4,
+  .directionPin = 16,
+  .enablePin = 17
+};
+
+static machineGeometry testMachine = {
+  .physicalTravel = 160.0,
+  .keepoutBoundary = 5.0
+};
+
+//! Initialize and home a simulated engine, it is READY at position 0 afterwards
+inline void beginAndHome(StrokeEngineSimulation &engine) {
+  engine.begin(&testMachine, &testMotor);
+  engine.thisIsHome();
+  while (engine.stepper().isRunning()) {
+    engine.run(1000);
+  }
+}
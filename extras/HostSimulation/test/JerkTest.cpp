@@ -0,0 +1,58 @@
+/**
+ *   Reports the peak jerk of every pattern on the VirtualStepper with the jerk
+ *   limit set by setMaxJerk(). The StrokeEngine converts the limit into the
+ *   length of the linear acceleration ramp of FastAccelStepper, a³ / 6j² steps.
+ *   The jerk the stepper actually runs with must stay within the limit.
+ */
+
+#include "HostTest.h"
+
+#define RUN_MICROS          6000000     // Simulated time each pattern runs
+#define TOLERANCE           1.02        // Integration error of the VirtualStepper
+
+StrokeEngineSimulation engine;
+
+// Peak jerk of a pattern in mm/s³
+static float peakJerk(unsigned int index, float maxJerk, float speed) {
+  engine.setPattern(index, false);
+  engine.setDepth(140.0, false);
+  engine.setStroke(80.0, false);
+  engine.setSpeed(speed, false);
+  engine.setSensation(50.0, false);
+  engine.setMaxJerk(maxJerk);
+  engine.startPattern();
+
+  // The jerk of the move bringing the axis into position is not of interest
+  engine.run(1000000);
+  engine.stepper().resetPeaks();
+  engine.run(RUN_MICROS);
+  float jerk = engine.stepper().getPeakJerk() / testMotor.stepsPerMillimeter;
+
+  engine.stopMotion();
+  engine.runUntilStopped();
+  return jerk;
+}
+
+int main() {
+  beginAndHome(engine);
+
+  // A soft and a hard limit, at a slow and a fast stroke rate
+  const float limits[] = {20000.0, 500000.0};
+  const float speeds[] = {30.0, 120.0};
+
+  printf("%-24s %12s %10s %14s\n", "Pattern", "limit", "speed", "peak jerk");
+  for (unsigned int i = 0; i < PatternRegistry::size(); i++) {
+    const char *name = PatternRegistry::get(i)->getName();
+    for (float limit : limits) {
+      for (float speed : speeds) {
+        float jerk = peakJerk(i, limit, speed);
+        printf("%-24s %8.0f mm/s³ %6.0f/min %9.0f mm/s³\n", name, limit, speed, jerk);
+        CHECK(jerk > 0.0, "%s did not move", name);
+        CHECK(jerk <= limit * TOLERANCE, "%s exceeded the jerk limit of %.0f mm/s³ with %.0f mm/s³", 
+          name, limit, jerk);
+      }
+    }
+  }
+
+  return TEST_RESULT();
+}
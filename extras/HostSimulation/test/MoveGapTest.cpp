@@ -0,0 +1,91 @@
+/**
+ *   Measures the gap between two moves on the VirtualStepper: the time from
+ *   the end of a move until the motion task issues the next one. The motion
+ *   task sleeps for the predicted duration of a move, so the gap shows how
+ *   good the prediction is. Mid-stroke updates retarget moves that are
+ *   already running, whose prediction must start from the current speed.
+ */
+
+#include "HostTest.h"
+
+#define RUN_MICROS          6000000     // Simulated time each pattern runs
+#define SAMPLE_MICROS       100         // Resolution of the gap measurement
+#define UPDATE_MICROS       700000      // Interval of mid-stroke updates
+#define MAX_GAP_MICROS      (portTICK_PERIOD_MS * 1000 + 2 * SAMPLE_MICROS)
+
+StrokeEngineSimulation engine;
+
+// Returns the longest gap between a move completing and the next one
+static uint32_t measureGaps(bool updates, uint32_t &gaps, uint32_t &moves, uint32_t &wakeups) {
+  uint32_t longest = 0;
+  uint64_t idleSince = 0;
+  bool idle = false;
+  gaps = 0;
+
+  engine.resetStats();
+  for (uint32_t t = 0; t < RUN_MICROS; t += SAMPLE_MICROS) {
+    // Retarget the running move with a new speed and stroke now and then
+    if (updates && (t % UPDATE_MICROS == UPDATE_MICROS / 2)) {
+      bool faster = (t / UPDATE_MICROS) % 2;
+      engine.setSpeed(faster ? 100.0 : 70.0, true);
+      engine.setStroke(faster ? 90.0 : 70.0, true);
+    }
+
+    engine.run(SAMPLE_MICROS);
+
+    bool running = engine.stepper().isRunning();
+    if (!running && !idle) {
+      idleSince = hostTime();
+    }
+    if (running && idle) {
+      longest = max(longest, uint32_t(hostTime() - idleSince));
+      gaps++;
+    }
+    idle = !running;
+  }
+  moves = engine.getStats().moves;
+  wakeups = engine.getStats().loopPeriod.count();
+  return longest;
+}
+
+static void testPattern(unsigned int index, bool updates) {
+  const char *name = PatternRegistry::get(index)->getName();
+
+  engine.setPattern(index, false);
+  engine.setDepth(140.0, false);
+  engine.setStroke(80.0, false);
+  engine.setSpeed(80.0, false);
+  engine.setSensation(20.0, false);
+  engine.startPattern();
+
+  uint32_t gaps = 0;
+  uint32_t moves = 0;
+  uint32_t wakeups = 0;
+  uint32_t gap = measureGaps(updates, gaps, moves, wakeups);
+  engine.stopMotion();
+  engine.runUntilStopped();
+
+  printf("%-24s %-8s moves %4u  completed %4u  wake-ups %4u  longest gap %5u us\n", name, 
+    updates ? "updates" : "steady", unsigned(moves), unsigned(gaps), unsigned(wakeups), unsigned(gap));
+  CHECK(moves > 10, "%s issued only %u moves", name, unsigned(moves));
+  CHECK(gaps > 2, "%s completed only %u moves", name, unsigned(gaps));
+  CHECK(gap <= MAX_GAP_MICROS, "%s waited %u us for the next move", name, unsigned(gap));
+
+  // Waking up before a move completes is wasted. Each move may need a second 
+  // wake-up for rounding, each update one more.
+  uint32_t updateCount = updates ? (RUN_MICROS / UPDATE_MICROS) : 0;
+  CHECK(wakeups <= 2 * moves + 2 * updateCount + 2, "%s woke up %u times for %u moves", 
+    name, unsigned(wakeups), unsigned(moves));
+}
+
+int main() {
+  beginAndHome(engine);
+
+  // Patterns without pauses between strokes
+  for (unsigned int i = 0; i < 5; i++) {
+    testPattern(i, false);
+    testPattern(i, true);
+  }
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,233 @@
+/**
+ *   Opens pattern files built in memory. A valid file must load into a
+ *   KeyframePattern, a SequencePattern and a SequencePlayer and produce the
+ *   targets of its data. Files with a bad header, misaligned or out of range
+ *   data, or counts overrunning the file must be rejected. Pauses of a
+ *   sequence must be held for their duration scaled by the time of stroke.
+ */
+
+#include "HostTest.h"
+#include <PatternFile.h>
+#include <vector>
+
+#define STROKE              1000        // Stroke and depth in steps the patterns run with
+
+static const keyframe keyframes[] = {
+  {100, 1, EASE_SMOOTH, 0, 0},
+  {0, 1, EASE_LINEAR, 0, 0}
+};
+
+// In within 500ms, hold 1000ms, out within 500ms
+static const sequencePoint points[] = {
+  {10000, 500},
+  {10000, 1000},
+  {0, 500}
+};
+
+// In and out at 1.5 strokes/s and 9 strokes/s²
+static const plannedMove moves[] = {
+  {10000, 1000, 0x18000, 0x90000},
+  {0, 1000, 0x18000, 0x90000}
+};
+
+// Pattern file with one entry of each type. Words keep the data 4 byte aligned.
+static std::vector<uint32_t> buildFile() {
+  const void *data[] = {keyframes, points, moves};
+  const size_t sizes[] = {sizeof(keyframes), sizeof(points), sizeof(moves)};
+  const uint16_t counts[] = {2, 3, 2};
+  const char *names[] = {"Keys", "Sequence", "Moves"};
+
+  size_t size = sizeof(patternFileHeader) + 3 * sizeof(patternFileEntry);
+  std::vector<uint8_t> file(size, 0);
+  for (int i = 0; i < 3; i++) {
+    patternFileEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.name, names[i], PATTERN_FILE_NAME_LEN - 1);
+    entry.type = PATTERN_FILE_KEYFRAMES + i;
+    entry.count = counts[i];
+    entry.offset = uint32_t(file.size());
+    memcpy(&file[sizeof(patternFileHeader) + i * sizeof(patternFileEntry)], &entry, sizeof(entry));
+
+    file.insert(file.end(), (const uint8_t *)data[i], (const uint8_t *)data[i] + sizes[i]);
+    file.resize((file.size() + 3) & ~size_t(3), 0);
+  }
+
+  patternFileHeader header;
+  memcpy(header.magic, PATTERN_FILE_MAGIC, 4);
+  header.version = PATTERN_FILE_VERSION;
+  header.entries = 3;
+  header.size = uint32_t(file.size());
+  header.reserved = 0;
+  memcpy(&file[0], &header, sizeof(header));
+
+  std::vector<uint32_t> words(file.size() / 4);
+  memcpy(words.data(), file.data(), file.size());
+  return words;
+}
+
+static patternFileHeader *header(std::vector<uint32_t> &file) {
+  return (patternFileHeader *)file.data();
+}
+
+static patternFileEntry *entry(std::vector<uint32_t> &file, int index) {
+  return (patternFileEntry *)((uint8_t *)file.data() + sizeof(patternFileHeader)) + index;
+}
+
+static void expectRejected(std::vector<uint32_t> file, const char *reason) {
+  PatternFile patternFile;
+  CHECK(patternFile.openBuffer(file.data(), file.size() * 4) == false, "A file with %s was accepted", reason);
+  CHECK(patternFile.count() == 0, "A rejected file with %s has %u entries", reason, patternFile.count());
+}
+
+static void testRejected() {
+  std::vector<uint32_t> file;
+
+  file = buildFile();
+  header(file)->magic[0] = 'X';
+  expectRejected(file, "a bad magic");
+
+  file = buildFile();
+  header(file)->version = PATTERN_FILE_VERSION + 1;
+  expectRejected(file, "a wrong version");
+
+  file = buildFile();
+  header(file)->size += 4;
+  expectRejected(file, "a size beyond the buffer");
+
+  file = buildFile();
+  header(file)->entries = 200;
+  expectRejected(file, "a directory beyond the file");
+
+  file = buildFile();
+  entry(file, 1)->offset += 2;
+  expectRejected(file, "a misaligned offset");
+
+  file = buildFile();
+  entry(file, 1)->offset = header(file)->size + 4;
+  expectRejected(file, "an offset beyond the file");
+
+  file = buildFile();
+  entry(file, 2)->count += 1;
+  expectRejected(file, "a count overrunning the file");
+
+  file = buildFile();
+  entry(file, 0)->type = 7;
+  expectRejected(file, "an unknown type");
+
+  file = buildFile();
+  memset(entry(file, 0)->name, 'A', PATTERN_FILE_NAME_LEN);
+  expectRejected(file, "an unterminated name");
+
+  // Header and data are read in place, so the buffer itself must be aligned
+  file = buildFile();
+  std::vector<uint8_t> shifted(file.size() * 4 + 4);
+  memcpy(&shifted[2], file.data(), file.size() * 4);
+  PatternFile patternFile;
+  CHECK(patternFile.openBuffer(&shifted[2], file.size() * 4) == false, "A misaligned buffer was accepted");
+  CHECK(patternFile.openBuffer(file.data(), sizeof(patternFileHeader) - 1) == false, "A truncated header was accepted");
+  CHECK(patternFile.openBuffer(NULL, 0) == false, "No buffer was accepted");
+  CHECK(patternFile.openFile("PatternFileTest.missing") == false, "A missing file was accepted");
+}
+
+static void testKeyframes(PatternFile &file) {
+  KeyframePattern pattern("Unnamed", NULL, 0);
+  CHECK(file.load(0, &pattern), "The keyframes did not load");
+  CHECK(strcmp(pattern.getName(), "Keys") == 0, "The keyframes are named %s", pattern.getName());
+  pattern.setStroke(STROKE);
+  pattern.setDepth(STROKE);
+  pattern.setTimeOfStroke(1.0);
+
+  // Both moves take half the time of stroke over the full stroke
+  TrapezoidProfile smooth, linear;
+  smooth.setTime(0.5);
+  linear.setTime(0.5, 0.05f);
+  motionParameter in = pattern.nextTarget(0);
+  motionParameter out = pattern.nextTarget(1);
+  CHECK((in.stroke == STROKE) && (out.stroke == 0), "The keyframes go to %d and %d", in.stroke, out.stroke);
+  CHECK((in.speed == smooth.speed(STROKE)) && (in.acceleration == smooth.acceleration(in.speed)),
+    "The smooth keyframe moves at %d steps/s and %d steps/s²", in.speed, in.acceleration);
+  CHECK((out.speed == linear.speed(STROKE)) && (out.acceleration == linear.acceleration(out.speed)),
+    "The linear keyframe moves at %d steps/s and %d steps/s²", out.speed, out.acceleration);
+  CHECK(!in.skip && !out.skip, "A keyframe was skipped");
+}
+
+static void testSequence(PatternFile &file) {
+  SequencePattern pattern("Unnamed");
+  CHECK(file.load(1, &pattern), "The sequence did not load");
+  CHECK(strcmp(pattern.getName(), "Sequence") == 0, "The sequence is named %s", pattern.getName());
+  CHECK(pattern.allowsLookahead() == false, "A sequence with a pause allows lookahead");
+  pattern.setStroke(STROKE);
+  pattern.setDepth(STROKE);
+  pattern.setTimeOfStroke(2.0);
+
+  // Played at half speed, the 500ms move takes 1s
+  TrapezoidProfile profile;
+  profile.setTime(1.0);
+  motionParameter in = pattern.nextTarget(0);
+  CHECK((in.stroke == STROKE) && !in.skip, "The sequence goes to %d", in.stroke);
+  CHECK((in.speed == profile.speed(STROKE)) && (in.acceleration == profile.acceleration(in.speed)),
+    "The sequence moves at %d steps/s and %d steps/s²", in.speed, in.acceleration);
+
+  // The pause holds for 2s
+  CHECK(pattern.nextTarget(1).skip, "The pause was not held");
+  delay(1990);
+  CHECK(pattern.nextTarget(1).skip, "The pause ended after 1990ms");
+  delay(20);
+  motionParameter hold = pattern.nextTarget(1);
+  CHECK(!hold.skip && (hold.stroke == STROKE), "The pause did not end after 2010ms");
+
+  motionParameter out = pattern.nextTarget(2);
+  CHECK((out.stroke == 0) && !out.skip, "The sequence goes to %d", out.stroke);
+}
+
+static void testMoves(PatternFile &file) {
+  SequencePlayer player("Unnamed");
+  CHECK(file.load(2, &player), "The moves did not load");
+  CHECK(strcmp(player.getName(), "Moves") == 0, "The moves are named %s", player.getName());
+  CHECK(player.allowsLookahead(), "Moves without a pause prevent lookahead");
+  player.setStroke(STROKE);
+  player.setDepth(STROKE);
+
+  // Speed and acceleration scale with the stroke
+  motionParameter in = player.nextTarget(0);
+  motionParameter out = player.nextTarget(1);
+  CHECK((in.stroke == STROKE) && (out.stroke == 0), "The moves go to %d and %d", in.stroke, out.stroke);
+  CHECK((in.speed == 1500) && (in.acceleration == 9000), "The moves run at %d steps/s and %d steps/s²",
+    in.speed, in.acceleration);
+}
+
+int main() {
+  std::vector<uint32_t> data = buildFile();
+  PatternFile file;
+  CHECK(file.openBuffer(data.data(), data.size() * 4), "The valid file was rejected");
+  CHECK(file.count() == 3, "The file has %u entries", file.count());
+  CHECK(file.getType(1) == PATTERN_FILE_SEQUENCE, "The sequence has type %u", file.getType(1));
+  CHECK(file.getName(3) == NULL, "An entry beyond the file has a name");
+
+  // Entries only load into patterns of their type
+  KeyframePattern keyframePattern("Unnamed", NULL, 0);
+  SequencePlayer player("Unnamed");
+  CHECK(file.load(1, &keyframePattern) == false, "A sequence loaded as keyframes");
+  CHECK(file.load(0, &player) == false, "Keyframes loaded as moves");
+  CHECK(file.load(3, &player) == false, "An entry beyond the file loaded");
+
+  testKeyframes(file);
+  testSequence(file);
+  testMoves(file);
+  testRejected();
+
+  // The same file mapped from the file system
+  FILE *output = fopen("PatternFileTest.bin", "wb");
+  CHECK(output != NULL, "The file could not be written");
+  if (output != NULL) {
+    fwrite(data.data(), 4, data.size(), output);
+    fclose(output);
+    PatternFile mapped;
+    CHECK(mapped.openFile("PatternFileTest.bin"), "The mapped file was rejected");
+    testSequence(mapped);
+    mapped.close();
+    remove("PatternFileTest.bin");
+  }
+
+  return TEST_RESULT();
+}
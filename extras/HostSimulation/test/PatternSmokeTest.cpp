@@ -0,0 +1,98 @@
+/**
+ *   Runs every built-in pattern, a keyframe pattern and the streaming of LivePosition through
+ *   the StrokeEngine with a VirtualStepper. Each must keep moving, stay within
+ *   the travel and stop cleanly.
+ */
+
+#include "HostTest.h"
+
+#define RUN_MICROS          10000000    // Simulated time each pattern runs
+#define SAMPLE_MICROS       1000        // Interval of the position samples
+
+StrokeEngineSimulation engine;
+
+// Stairway of the KeyframePatterns example, so keyframe patterns are covered too
+static const keyframe stairwayKeyframes[] = {
+  {33, 1, EASE_SMOOTH, 0, -50},
+  {66, 1, EASE_SMOOTH, 0, -50},
+  {100, 1, EASE_SMOOTH, 0, -50},
+  {0, 3, EASE_SMOOTH, 0, 50}
+};
+static KeyframePattern stairway("Stairway", stairwayKeyframes, sizeof(stairwayKeyframes) / sizeof(keyframe));
+REGISTER_PATTERN_INSTANCE(stairway);
+
+// Runs the engine and returns the range of positions it passed
+static void runAndTrack(uint32_t micros, int &lowest, int &highest) {
+  for (uint32_t t = 0; t < micros; t += SAMPLE_MICROS) {
+    engine.run(SAMPLE_MICROS);
+    int position = engine.stepper().getCurrentPosition();
+    lowest = min(lowest, position);
+    highest = max(highest, position);
+  }
+}
+
+static void testPattern(unsigned int index) {
+  const char *name = PatternRegistry::get(index)->getName();
+  int maxStep = int(0.5 + (testMachine.physicalTravel - 2 * testMachine.keepoutBoundary) * testMotor.stepsPerMillimeter);
+
+  engine.setPattern(index, false);
+  engine.setDepth(140.0, false);
+  engine.setStroke(80.0, false);
+  engine.setSpeed(60.0, false);
+  engine.setSensation(30.0, false);
+  engine.resetStats();
+  CHECK(engine.startPattern(), "%s did not start", name);
+
+  int lowest = maxStep;
+  int highest = 0;
+  runAndTrack(RUN_MICROS, lowest, highest);
+  motionStats stats = engine.getStats();
+
+  engine.stopMotion();
+  CHECK(engine.runUntilStopped(), "%s did not stop", name);
+  CHECK(engine.getState() == READY, "%s ended in state %d", name, engine.getState());
+
+  printf("%-24s moves %4u  range %5d .. %5d steps\n", name, unsigned(stats.moves), lowest, highest);
+  CHECK(stats.moves >= 4, "%s issued only %u moves", name, unsigned(stats.moves));
+  CHECK(highest > lowest, "%s never moved", name);
+  CHECK((lowest >= 0) && (highest <= maxStep), "%s left the travel", name);
+}
+
+static void testStreaming() {
+  engine.setDepth(140.0, false);
+  engine.setStroke(80.0, false);
+  engine.resetStats();
+  CHECK(engine.startStreaming(), "Streaming did not start");
+
+  // Full strokes in and out
+  int lowest = 100000;
+  int highest = 0;
+  for (int i = 0; i < 10; i++) {
+    CHECK(engine.appendToStreaming((i % 2) ? 0 : 100, 500, false), "Point %d was dropped", i);
+    runAndTrack(500000, lowest, highest);
+  }
+  motionStats stats = engine.getStats();
+
+  engine.stopMotion();
+  CHECK(engine.runUntilStopped(), "Streaming did not stop");
+
+  // 0% of stroke is depth - stroke, 100% is depth
+  int in = int(140.0 * testMotor.stepsPerMillimeter);
+  int out = int(60.0 * testMotor.stepsPerMillimeter);
+  printf("%-24s moves %4u  range %5d .. %5d steps\n", "LivePosition", unsigned(stats.moves), lowest, highest);
+  CHECK(stats.moves >= 10, "Streaming issued only %u moves", unsigned(stats.moves));
+  CHECK(abs(highest - in) <= 1, "Streaming reached %d instead of %d", highest, in);
+  CHECK(abs(lowest - out) <= 1, "Streaming reached %d instead of %d", lowest, out);
+}
+
+int main() {
+  beginAndHome(engine);
+
+  CHECK(PatternRegistry::size() > 0, "No patterns registered");
+  for (unsigned int i = 0; i < PatternRegistry::size(); i++) {
+    testPattern(i);
+  }
+  testStreaming();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,127 @@
+/**
+ *   Checks the endpoints of parameter ramps. A ramp starts at the current
+ *   values without a jump, moves monotonically towards the new values in one
+ *   step per move and ends exactly on them: after 2n moves for a ramp over
+ *   n strokes, with the first move after the ramp time for a ramp over time.
+ */
+
+#include "HostTest.h"
+
+#define MAX_RECORDS         256
+#define START_DEPTH         150.0
+#define TARGET_DEPTH        60.0
+#define START_SPEED         60.0
+#define TARGET_SPEED        90.0
+
+// Simple Stroke that records every depth and time of stroke it is given
+class RecordingPattern : public SimpleStroke {
+  public:
+    RecordingPattern(const char *str) : SimpleStroke(str) {}
+
+    void setTimeOfStroke(float speed = 0) {
+      SimpleStroke::setTimeOfStroke(speed);
+      lastTimeOfStroke = speed;
+    }
+
+    void setDepth(int depth) {
+      SimpleStroke::setDepth(depth);
+      if (recording && (count < MAX_RECORDS)) {
+        depths[count++] = depth;
+      }
+    }
+
+    void startRecording() {
+      count = 0;
+      recording = true;
+    }
+
+    bool recording = false;
+    unsigned int count = 0;
+    int depths[MAX_RECORDS];
+    float lastTimeOfStroke = 0.0;
+};
+
+static RecordingPattern recorder("Ramp Recorder");
+REGISTER_PATTERN_INSTANCE(recorder);
+
+StrokeEngineSimulation engine;
+
+static void testRamp(rampMode mode, float length) {
+  int start = int(START_DEPTH * testMotor.stepsPerMillimeter);
+  int target = int(TARGET_DEPTH * testMotor.stepsPerMillimeter);
+
+  engine.setRamp(mode, length);
+  engine.setPattern(PatternRegistry::size() - 1, false);
+  engine.setDepth(START_DEPTH, false);
+  engine.setStroke(40.0, false);
+  engine.setSpeed(START_SPEED, false);
+  CHECK(engine.startPattern(), "Ramp mode %d did not start", mode);
+  engine.run(3000000);
+
+  // Change and wait until the ramp is over
+  recorder.startRecording();
+  engine.resetStats();
+  uint64_t changed = hostTime();
+  engine.setDepth(TARGET_DEPTH, true);
+  engine.setSpeed(TARGET_SPEED, true);
+  uint64_t done = 0;
+  for (int i = 0; (i < 20000) && (done == 0); i++) {
+    engine.run(1000);
+    if (!engine.isRamping() && (recorder.count > 0)) {
+      done = hostTime() - changed;
+    }
+  }
+  unsigned int moves = engine.getStats().moves;
+  engine.stopMotion();
+  CHECK(engine.runUntilStopped(), "Ramp mode %d did not stop", mode);
+
+  printf("Ramp mode %d length %.1f: %u steps, done after %.3f s and %u moves\n", mode, length, 
+    recorder.count, done / 1.0e6, moves);
+  CHECK(done > 0, "Ramp mode %d never ended", mode);
+  CHECK(recorder.count > 0, "Ramp mode %d never changed the depth", mode);
+  if (recorder.count == 0) {
+    return;
+  }
+
+  // Ends exactly on the new values
+  CHECK(recorder.depths[recorder.count - 1] == target, "Ramp mode %d ended at depth %d instead of %d", 
+    mode, recorder.depths[recorder.count - 1], target);
+  CHECK(recorder.lastTimeOfStroke == float(60.0 / TARGET_SPEED), "Ramp mode %d ended at time of stroke %f", 
+    mode, recorder.lastTimeOfStroke);
+
+  // Monotonic between the old and the new value
+  int previous = start;
+  for (unsigned int i = 0; i < recorder.count; i++) {
+    CHECK((recorder.depths[i] < previous) && (recorder.depths[i] >= target), 
+      "Ramp mode %d step %u to depth %d after %d", mode, i, recorder.depths[i], previous);
+    previous = recorder.depths[i];
+  }
+
+  if (mode == RAMP_NONE) {
+    CHECK(recorder.count == 1, "Without ramp the depth changed in %u steps", recorder.count);
+    return;
+  }
+
+  // Starts without a jump: the first step is at most one step of the ramp
+  int firstStep = start - recorder.depths[0];
+  if (mode == RAMP_STROKES) {
+    CHECK(recorder.count == unsigned(2 * length), "Ramp over %.0f strokes took %u steps", length, recorder.count);
+    CHECK(firstStep <= (start - target) / int(2 * length) + 1, "Ramp started with a step of %d", firstStep);
+  } else {
+    // Each step covers one move of at most half a stroke at the start speed
+    float longestMove = 0.5 * 60.0 / START_SPEED;
+    CHECK(firstStep <= int((start - target) * longestMove / length) + 1, "Ramp started with a step of %d", firstStep);
+    CHECK((done >= uint64_t(length * 1.0e6)) && (done <= uint64_t((length + longestMove) * 1.0e6)), 
+      "Ramp over %.1f s ended after %.3f s", length, done / 1.0e6);
+  }
+}
+
+int main() {
+  beginAndHome(engine);
+
+  testRamp(RAMP_NONE, 0.0);
+  testRamp(RAMP_STROKES, 4.0);
+  testRamp(RAMP_TIME, 3.0);
+
+  return TEST_RESULT();
+}
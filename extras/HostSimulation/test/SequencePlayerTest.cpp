@@ -0,0 +1,124 @@
+/**
+ *   Compiles a small funscript with the funscript compiler, loads the pattern
+ *   file into a SequencePlayer and plays it through the StrokeEngine. The
+ *   pauses of the script must be held for their duration and one pass through
+ *   the script must take as long as its compiled moves add up to.
+ *   Arguments: path of the funscript compiler, directory for the files.
+ */
+
+#include "HostTest.h"
+#include <PatternFile.h>
+#include <string>
+#include <vector>
+
+#define RUN_MICROS          12000000    // Simulated time the script plays, more than two passes
+#define SAMPLE_MICROS       1000        // Interval of the position samples
+#define TOLERANCE_MS        20          // Allowed overshoot of a hold, which is polled every PAUSE_POLL_MS
+
+// In at 0.5s, hold 1s, out at 2s, hold 2s, half way at 4.5s
+static const char *script =
+  "{\"actions\":[{\"at\":0,\"pos\":0},{\"at\":500,\"pos\":100},{\"at\":1500,\"pos\":100},"
+  "{\"at\":2000,\"pos\":0},{\"at\":4000,\"pos\":0},{\"at\":4500,\"pos\":50}]}";
+
+#define HOLD_IN_MS          1000
+#define HOLD_OUT_MS         2000
+
+StrokeEngineSimulation engine;
+static SequencePlayer player("Script");
+REGISTER_PATTERN_INSTANCE(player);
+
+// Writes the script and compiles it for the travel and limits of the test machine
+static bool compileScript(const char *compiler, const std::string &scriptPath, const std::string &filePath) {
+  FILE *file = fopen(scriptPath.c_str(), "w");
+  if (file == NULL) {
+    return false;
+  }
+  fputs(script, file);
+  fclose(file);
+
+  char command[1024];
+  snprintf(command, sizeof(command), "\"%s\" -t %f -v %f -a %f -o \"%s\" \"%s\"", compiler,
+    testMachine.physicalTravel - 2 * testMachine.keepoutBoundary, testMotor.maxSpeed, testMotor.maxAcceleration,
+    filePath.c_str(), scriptPath.c_str());
+  return system(command) == 0;
+}
+
+// Durations of the stretches the axis stayed at a position, and the times it arrived there
+static void track(int position, int current, uint32_t now, uint32_t &since, std::vector<uint32_t> &arrivals, uint32_t &longest) {
+  if (current != position) {
+    since = 0;
+    return;
+  }
+  if (since == 0) {
+    since = now;
+    arrivals.push_back(now);
+  }
+  longest = max(longest, now - since);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    printf("Usage: SequencePlayerTest <funscript compiler> <directory>\n");
+    return 1;
+  }
+  std::string scriptPath = std::string(argv[2]) + "/SequencePlayerTest.funscript";
+  std::string filePath = std::string(argv[2]) + "/SequencePlayerTest.bin";
+  CHECK(compileScript(argv[1], scriptPath, filePath), "The funscript compiler failed");
+
+  PatternFile file;
+  CHECK(file.openFile(filePath.c_str()), "The pattern file is invalid");
+  CHECK(file.load(0, &player), "The script could not be loaded");
+
+  // Time of one pass as compiled, from the moves in the file
+  std::vector<uint8_t> data(65536);
+  FILE *compiled = fopen(filePath.c_str(), "rb");
+  data.resize(compiled ? fread(data.data(), 1, data.size(), compiled) : 0);
+  if (compiled) {
+    fclose(compiled);
+  }
+  patternFileEntry entry;
+  memcpy(&entry, &data[sizeof(patternFileHeader)], sizeof(entry));
+  uint32_t passMillis = 0;
+  for (unsigned int i = 0; i < entry.count; i++) {
+    plannedMove move;
+    memcpy(&move, &data[entry.offset + i * sizeof(plannedMove)], sizeof(move));
+    passMillis += move.duration;
+  }
+
+  beginAndHome(engine);
+  engine.setPattern(PatternRegistry::size() - 1, false);
+  engine.setDepth(testMachine.physicalTravel - 2 * testMachine.keepoutBoundary, false);
+  engine.setStroke(testMachine.physicalTravel - 2 * testMachine.keepoutBoundary, false);
+  engine.resetStats();
+  CHECK(engine.startPattern(), "The script did not start");
+
+  // 0% of stroke is depth - stroke, 100% is depth
+  int in = int(0.5 + (testMachine.physicalTravel - 2 * testMachine.keepoutBoundary) * testMotor.stepsPerMillimeter);
+  int out = 0;
+  uint32_t inSince = 0, outSince = 0;
+  uint32_t holdIn = 0, holdOut = 0;
+  std::vector<uint32_t> inArrivals, outArrivals;
+  for (uint32_t t = SAMPLE_MICROS; t <= RUN_MICROS; t += SAMPLE_MICROS) {
+    engine.run(SAMPLE_MICROS);
+    int position = engine.stepper().getCurrentPosition();
+    track(in, position, t / 1000, inSince, inArrivals, holdIn);
+    track(out, position, t / 1000, outSince, outArrivals, holdOut);
+  }
+  motionStats stats = engine.getStats();
+
+  engine.stopMotion();
+  CHECK(engine.runUntilStopped(), "The script did not stop");
+
+  uint32_t pass = (inArrivals.size() >= 2) ? inArrivals[1] - inArrivals[0] : 0;
+  printf("%u moves, held in %ums, held out %ums, pass %ums of %ums compiled\n", unsigned(stats.moves),
+    unsigned(holdIn), unsigned(holdOut), unsigned(pass), unsigned(passMillis));
+  CHECK((holdIn >= HOLD_IN_MS) && (holdIn <= HOLD_IN_MS + TOLERANCE_MS), "The pause in was held for %ums", unsigned(holdIn));
+  CHECK((holdOut >= HOLD_OUT_MS) && (holdOut <= HOLD_OUT_MS + TOLERANCE_MS), "The pause out was held for %ums", unsigned(holdOut));
+  CHECK(passMillis >= 4500, "The compiled moves add up to %ums only", unsigned(passMillis));
+  CHECK((pass >= passMillis) && (pass <= passMillis + 2 * TOLERANCE_MS), "A pass took %ums instead of %ums", unsigned(pass), unsigned(passMillis));
+
+  file.close();
+  remove(scriptPath.c_str());
+  remove(filePath.c_str());
+  return TEST_RESULT();
+}
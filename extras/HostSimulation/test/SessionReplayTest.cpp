@@ -0,0 +1,119 @@
+/**
+ *   Records a session of pattern and streaming moves, exports it and replays
+ *   it with SessionReplayer. The replayed moves must match the recorded ones.
+ *   A session with one altered move and one altered clipping flag must be
+ *   reported as diverging at exactly those events.
+ */
+
+#include <vector>
+#include <SessionReplayer.h>
+#include "HostTest.h"
+
+StrokeEngineSimulation engine;
+SessionReplayer replayer;
+
+// Exports the recorded session into a 4 byte aligned buffer
+static size_t exportSession(std::vector<uint32_t> &buffer) {
+  buffer.assign(engine.getSessionSize() / 4 + 1, 0);
+  return engine.exportSession(buffer.data(), buffer.size() * 4);
+}
+
+static sessionEvent *events(std::vector<uint32_t> &buffer) {
+  return (sessionEvent *)((uint8_t *)buffer.data() + sizeof(sessionFileHeader));
+}
+
+static void recordSession() {
+  engine.clearSession();
+
+  // Pattern with updates between strokes and mid-stroke. Stop'n'Go and ramps 
+  // depend on time, so a time independent pattern is used.
+  engine.setPattern(2, false);
+  engine.setDepth(140.0, false);
+  engine.setStroke(80.0, false);
+  engine.setSpeed(120.0, false);
+  engine.startPattern();
+  engine.run(1200000);
+  engine.setSensation(40.0, false);
+  engine.setStroke(60.0, false);
+  engine.run(1000000);
+  engine.setSpeed(90.0, true);
+  engine.setDepth(120.0, true);
+  engine.run(1000000);
+  engine.stopMotion();
+  engine.runUntilStopped();
+
+  // Streaming, some of the moves too fast to be done in time. An empty 
+  // queue is polled and recorded every PAUSE_POLL_MS, so queue all points first.
+  engine.startStreaming();
+  for (int i = 0; i < 8; i++) {
+    engine.appendToStreaming((i % 2) ? 10 : 90, (i < 4) ? 400 : 25, false);
+  }
+  engine.run(1800000);
+  engine.stopMotion();
+  engine.runUntilStopped();
+}
+
+int main() {
+  beginAndHome(engine);
+  recordSession();
+
+  std::vector<uint32_t> session;
+  size_t size = exportSession(session);
+  uint32_t count = (size - sizeof(sessionFileHeader)) / sizeof(sessionEvent);
+  CHECK(count < SESSION_RECORDER_DEPTH, "Session of %u events overflowed the recorder", unsigned(count));
+
+  // Recorded moves and computations from the first start on
+  int start = -1;
+  uint32_t recordedMoves = 0;
+  uint32_t recordedComputes = 0;
+  int computeEvent = -1;
+  int moveEvent = -1;
+  for (uint32_t i = 0; i < count; i++) {
+    if ((start < 0) && (events(session)[i].type == SESSION_LIMITS)) {
+      start = i;
+    }
+    if (events(session)[i].type == SESSION_COMPUTE) {
+      recordedComputes++;
+      if ((computeEvent < 0) && (recordedComputes == 5)) {
+        computeEvent = i;
+      }
+    }
+    if (events(session)[i].type == SESSION_MOVE) {
+      recordedMoves++;
+      if ((moveEvent < 0) && (recordedMoves == 12)) {
+        moveEvent = i;
+      }
+    }
+  }
+
+  // Replay as recorded
+  CHECK(replayer.open(session.data(), size), "Session file is invalid");
+  sessionReplayResult result = replayer.replay(true);
+  printf("Replay: %u events, %u computes, %u moves, %u clipped, axis error %d steps\n", 
+    unsigned(result.events), unsigned(result.computes), unsigned(result.moves), 
+    unsigned(result.clippedMoves), int(result.maxAxisError));
+  CHECK(result.events == count - start, "Replayed %u of %u events", unsigned(result.events), unsigned(count - start));
+  CHECK(result.computes == recordedComputes, "Replayed %u of %u computes", 
+    unsigned(result.computes), unsigned(recordedComputes));
+  CHECK(result.moves == recordedMoves, "Replayed %u of %u moves", unsigned(result.moves), unsigned(recordedMoves));
+  CHECK(result.clippedMoves > 0, "Session has no clipped move to compare");
+  CHECK(result.computeMismatches == 0, "%u computed moves differ", unsigned(result.computeMismatches));
+  CHECK(result.clipMismatches == 0, "%u moves clipped differently", unsigned(result.clipMismatches));
+  CHECK(result.firstMismatch == -1, "First mismatch at event %d", int(result.firstMismatch));
+
+  // An altered move is found at its event
+  CHECK((computeEvent >= 0) && (moveEvent > computeEvent), "Session too short to alter");
+  events(session)[computeEvent].data[0] += 1;
+  CHECK(replayer.open(session.data(), size), "Altered session file is invalid");
+  result = replayer.replay(false);
+  CHECK(result.computeMismatches == 1, "Found %u instead of 1 altered move", unsigned(result.computeMismatches));
+  CHECK(result.firstMismatch == computeEvent, "Altered move %d reported at %d", computeEvent, int(result.firstMismatch));
+
+  // An altered clipping flag as well
+  events(session)[moveEvent].flags ^= TELEMETRY_CLIP_SPEED;
+  result = replayer.replay(false);
+  CHECK(result.clipMismatches == 1, "Found %u instead of 1 altered clipping", unsigned(result.clipMismatches));
+  CHECK(result.firstMismatch == computeEvent, "First mismatch %d instead of %d", int(result.firstMismatch), computeEvent);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,71 @@
+/**
+ *   FastAccelStepper Backend of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <FastAccelStepper.h>
+#include "StepperBackend.h"
+
+/**************************************************************************/
+/*!
+  @class FastAccelStepperBackend
+  @brief  Default backend driving a stepper or servo with a STEP/DIR
+          interface through FastAccelStepper.
+*/
+/**************************************************************************/
+class FastAccelStepperBackend : public StepperBackend {
+
+    public:
+        //! Connects FastAccelStepper to the pins. The outputs are disabled afterwards.
+        /*!
+          @param stepPin Pin connected to the STEP input
+          @param directionPin Pin connected to the DIR input
+          @param invertDirection Set to true to invert the direction signal
+          @param enablePin Pin connected to the ENA input
+          @param enableActiveLow Polarity of the enable signal. True for active low.
+          @return true on success, false if no stepper could be connected to stepPin
+        */
+        bool begin(int stepPin, int directionPin, bool invertDirection, int enablePin, bool enableActiveLow) {
+            _engine.init();
+            _stepper = _engine.stepperConnectToPin(stepPin);
+            if (_stepper) {
+                _stepper->setDirectionPin(directionPin, invertDirection);
+                _stepper->setEnablePin(enablePin, enableActiveLow);
+                _stepper->setAutoEnable(false);
+                _stepper->disableOutputs();
+                return true;
+            }
+            return false;
+        }
+
+        void enableOutputs() { _stepper->enableOutputs(); }
+        void disableOutputs() { _stepper->disableOutputs(); }
+        int8_t setSpeedInHz(uint32_t speed) { return _stepper->setSpeedInHz(speed); }
+        int8_t setAcceleration(int32_t acceleration) { return _stepper->setAcceleration(acceleration); }
+        void setLinearAcceleration(uint32_t steps) { _stepper->setLinearAcceleration(steps); }
+        void applySpeedAcceleration() { _stepper->applySpeedAcceleration(); }
+        int8_t moveTo(int32_t position) { return _stepper->moveTo(position); }
+        int8_t move(int32_t distance) { return _stepper->move(distance); }
+        int8_t runForward() { return _stepper->runForward(); }
+        int8_t runBackward() { return _stepper->runBackward(); }
+        void stopMove() { _stepper->stopMove(); }
+        void forceStopAndNewPosition(int32_t position) { _stepper->forceStopAndNewPosition(position); }
+        void setCurrentPosition(int32_t position) { _stepper->setCurrentPosition(position); }
+        bool isRunning() { return _stepper->isRunning(); }
+        int32_t getCurrentPosition() { return _stepper->getCurrentPosition(); }
+        int32_t getCurrentSpeedInMilliHz() { return _stepper->getCurrentSpeedInMilliHz(); }
+        uint32_t getSpeedInMilliHz() { return _stepper->getSpeedInMilliHz(); }
+        uint32_t getAcceleration() { return _stepper->getAcceleration(); }
+
+    protected:
+        FastAccelStepperEngine _engine = FastAccelStepperEngine();
+        FastAccelStepper *_stepper = NULL;
+};
@@ -0,0 +1,98 @@
+/**
+ *   Offline Motion Planner of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ * Free of any Arduino dependency, so host tools can share it with the firmware.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+/**************************************************************************/
+/*!
+  @brief  One precomputed move of a compiled script, as played by a
+  SequencePlayer. Position, speed and acceleration are normalized to the
+  stroke, so the stream is independent of the machine's steps per mm and
+  of the stroke set at runtime. Speed and acceleration are already clipped
+  to the machine limits for a full stroke. Smaller strokes scale them down
+  and stay within the limits as well. 12 bytes without padding.
+*/
+/**************************************************************************/
+typedef struct {
+    uint16_t position;          //!< Target in 1/100 percent of stroke. 0 = depth - stroke, 10000 = depth
+    uint16_t duration;          //!< Planned duration of the move in [ms]
+    uint32_t speed;             //!< Maximum speed in strokes/s as Q16.16
+    uint32_t acceleration;      //!< Acceleration in strokes/s² as Q16.16
+} plannedMove;
+
+/**************************************************************************/
+/*!
+  @brief  Result of planTrapezoid(). Units follow the units of the input.
+*/
+/**************************************************************************/
+typedef struct {
+    float time;                 //!< Time the move takes
+    float speed;                //!< Maximum speed of the trapezoid
+    float acceleration;         //!< Acceleration and deceleration of the trapezoid
+    bool clipped;               //!< True if the move could not be done in the requested time
+} plannedProfile;
+
+/**************************************************************************/
+/*!
+  @brief  Plans a trapezoidal move within speed and acceleration limits.
+  Prefers the 1/3 accelerate, 1/3 coast, 1/3 decelerate profile the patterns
+  use. If that exceeds a limit, the move uses the full acceleration and the
+  lowest top speed that still arrives in time. If even the fastest possible
+  move can't make it, the move is clipped and takes longer than requested.
+  @param distance        distance to travel, >= 0
+  @param time            requested time of the move
+  @param maxSpeed        speed limit, > 0
+  @param maxAcceleration acceleration limit, > 0
+  @return planned profile
+*/
+/**************************************************************************/
+inline plannedProfile planTrapezoid(float distance, float time, float maxSpeed, float maxAcceleration) {
+    plannedProfile profile = {time, 0.0f, 0.0f, false};
+
+    if (distance <= 0.0f) {
+        return profile;
+    }
+
+    // Fastest possible move: trapezoid at top speed or triangle
+    float minimumTime;
+    if (distance >= maxSpeed * maxSpeed / maxAcceleration) {
+        minimumTime = distance / maxSpeed + maxSpeed / maxAcceleration;
+    } else {
+        minimumTime = 2.0f * sqrtf(distance / maxAcceleration);
+    }
+
+    if (time < minimumTime) {
+        profile.time = minimumTime;
+        profile.speed = fminf(maxSpeed, sqrtf(distance * maxAcceleration));
+        profile.acceleration = maxAcceleration;
+        profile.clipped = true;
+        return profile;
+    }
+
+    // Preferred 1/3 profile
+    profile.speed = 1.5f * distance / time;
+    profile.acceleration = 3.0f * profile.speed / time;
+    if ((profile.speed <= maxSpeed) && (profile.acceleration <= maxAcceleration)) {
+        return profile;
+    }
+
+    // Full acceleration, solve distance = v * (time - v / a) for the lower speed
+    float a = maxAcceleration;
+    float discriminant = fmaxf(a * a * time * time - 4.0f * a * distance, 0.0f);
+    profile.acceleration = a;
+    profile.speed = fminf(0.5f * (a * time - sqrtf(discriminant)), maxSpeed);
+    return profile;
+}
@@ -0,0 +1,128 @@
+/**
+ *   Motion Loop Statistics of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define STATS_HISTOGRAM_BUCKETS   24      // Bucket 0 holds 0µs, bucket i holds [2^(i-1), 2^i) µs. The 
+                                          // last bucket holds everything from 2^22 µs = 4.2s upwards.
+
+/**************************************************************************/
+/*!
+  @class StatsHistogram
+  @brief  Histogram of durations in µs with logarithmic buckets. Adding a 
+          sample is a handful of integer operations and never allocates, so
+          it can be used inside the motion task. Keeps the exact minimum,
+          maximum and sum next to the buckets.
+*/
+/**************************************************************************/
+class StatsHistogram {
+
+    public:
+        //! Add a sample
+        /*!
+          @param micros duration in µs
+        */
+        void add(uint32_t micros) {
+            unsigned int bucket = (micros == 0) ? 0 : 32 - __builtin_clz(micros);
+            if (bucket >= STATS_HISTOGRAM_BUCKETS) {
+                bucket = STATS_HISTOGRAM_BUCKETS - 1;
+            }
+            _buckets[bucket]++;
+
+            if ((_count == 0) || (micros < _min)) {
+                _min = micros;
+            }
+            if (micros > _max) {
+                _max = micros;
+            }
+            _sum += micros;
+            _count++;
+        }
+
+        //! Number of samples
+        uint32_t count() const { return _count; }
+
+        //! Shortest sample in µs, 0 without samples
+        uint32_t min() const { return _min; }
+
+        //! Longest sample in µs, 0 without samples
+        uint32_t max() const { return _max; }
+
+        //! Average of all samples in µs, 0 without samples
+        uint32_t mean() const { return (_count > 0) ? uint32_t(_sum / _count) : 0; }
+
+        //! Number of samples in a bucket
+        /*!
+          @param bucket index of the bucket from 0 to STATS_HISTOGRAM_BUCKETS - 1
+          @return samples in [2^(bucket-1), 2^bucket) µs, 0 if bucket is out of range
+        */
+        uint32_t bucket(unsigned int bucket) const {
+            return (bucket < STATS_HISTOGRAM_BUCKETS) ? _buckets[bucket] : 0;
+        }
+
+        //! Upper bound of a percentile, resolved to the bucket boundaries
+        /*!
+          @param percent percentile from 0 to 100, e.g. 99
+          @return duration in µs below which at least percent of the samples are.
+                  Never more than max().
+        */
+        uint32_t percentile(float percent) const {
+            uint64_t threshold = uint64_t(percent * 0.01f * _count + 0.5f);
+            uint64_t accumulated = 0;
+            for (unsigned int i = 0; i < STATS_HISTOGRAM_BUCKETS - 1; i++) {
+                accumulated += _buckets[i];
+                if ((accumulated >= threshold) && (accumulated > 0)) {
+                    uint32_t bound = (i == 0) ? 0 : (uint32_t(1) << i) - 1;
+                    return (bound < _max) ? bound : _max;
+                }
+            }
+            return _max;
+        }
+
+        //! Discard all samples
+        void reset() {
+            for (unsigned int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+                _buckets[i] = 0;
+            }
+            _count = 0;
+            _min = 0;
+            _max = 0;
+            _sum = 0;
+        }
+
+    protected:
+        uint32_t _buckets[STATS_HISTOGRAM_BUCKETS] = {0};
+        uint32_t _count = 0;
+        uint32_t _min = 0;
+        uint32_t _max = 0;
+        uint64_t _sum = 0;
+};
+
+/**************************************************************************/
+/*!
+  @brief  Statistics of the motion tasks, returned by StrokeEngine::getStats().
+  Only collected if STROKEENGINE_STATS is defined, all zero otherwise.
+*/
+/**************************************************************************/
+typedef struct {
+  StatsHistogram loopPeriod;      /*> Time between two iterations of the stroking or streaming task in µs */
+  StatsHistogram nextTarget;      /*> Time a pattern needs to compute a move in µs */
+  StatsHistogram moveGap;         /*> Time from the predicted completion of a move until the next move is
+                                   *  issued in µs. Blended moves are issued early and count as 0. */
+  uint32_t mutexMisses;           /*> Iterations skipped because _patternMutex was taken */
+  uint32_t moves;                 /*> Moves issued by the stroking and streaming task */
+  uint32_t clippedSpeed;          /*> Moves slowed down to the maximum speed */
+  uint32_t clippedAcceleration;   /*> Moves limited to the maximum acceleration */
+  uint32_t clippedPosition;       /*> Targets constrained to the motion envelope */
+  uint32_t crashAvoidance;        /*> Updates whose deceleration was raised to avoid a crash */
+} motionStats;
@@ -0,0 +1,206 @@
+#include <string.h>
+#include "PatternFile.h"
+
+#ifdef STROKEENGINE_HOST_SIMULATION
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#else
+  #include <esp_partition.h>
+  #include <esp_spi_flash.h>
+#endif
+
+static_assert(sizeof(patternFileHeader) == 16, "Pattern file header must be 16 bytes");
+static_assert(sizeof(patternFileEntry) == 32, "Pattern file entry must be 32 bytes");
+static_assert(sizeof(keyframe) == 5, "keyframe must be packed to 5 bytes");
+static_assert(sizeof(sequencePoint) == 4, "sequencePoint must be packed to 4 bytes");
+static_assert(sizeof(plannedMove) == 12, "plannedMove must be packed to 12 bytes");
+
+bool PatternFile::openBuffer(const void *data, size_t size) {
+    close();
+    _data = (const uint8_t *)data;
+    _size = size;
+
+    if (_validate() == false) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+#ifdef STROKEENGINE_HOST_SIMULATION
+bool PatternFile::openFile(const char *path) {
+    close();
+
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if ((fstat(file, &status) != 0) || (status.st_size <= 0)) {
+        ::close(file);
+        return false;
+    }
+
+    // The mapping stays valid after the file descriptor is closed
+    void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    _mapping = mapping;
+    _mapped = true;
+    _data = (const uint8_t *)mapping;
+    _size = status.st_size;
+
+    if (_validate() == false) {
+        close();
+        return false;
+    }
+    return true;
+}
+#else
+bool PatternFile::openPartition(const char *label) {
+    close();
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == NULL) {
+        return false;
+    }
+
+    const void *mapping = NULL;
+    spi_flash_mmap_handle_t handle;
+    if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &mapping, &handle) != ESP_OK) {
+        return false;
+    }
+
+    _mappingHandle = handle;
+    _mapped = true;
+    _data = (const uint8_t *)mapping;
+    _size = partition->size;
+
+    if (_validate() == false) {
+        close();
+        return false;
+    }
+
+    // Partitions are larger than the file, only use what the header declares
+    _size = _header->size;
+    return true;
+}
+#endif
+
+void PatternFile::close() {
+    if (_mapped) {
+#ifdef STROKEENGINE_HOST_SIMULATION
+        munmap(_mapping, _size);
+#else
+        spi_flash_munmap(_mappingHandle);
+#endif
+    }
+    _data = NULL;
+    _header = NULL;
+    _entries = NULL;
+    _size = 0;
+    _mapping = NULL;
+    _mappingHandle = 0;
+    _mapped = false;
+}
+
+const char *PatternFile::getName(unsigned int index) {
+    if (index >= count()) {
+        return NULL;
+    }
+    return _entries[index].name;
+}
+
+uint16_t PatternFile::getType(unsigned int index) {
+    if (index >= count()) {
+        return 0;
+    }
+    return _entries[index].type;
+}
+
+bool PatternFile::load(unsigned int index, KeyframePattern *pattern) {
+    const patternFileEntry *entry = _entry(index, PATTERN_FILE_KEYFRAMES);
+    if ((entry == NULL) || (pattern == NULL)) {
+        return false;
+    }
+    pattern->setName(entry->name);
+    pattern->setKeyframes((const keyframe *)(_data + entry->offset), entry->count);
+    return true;
+}
+
+bool PatternFile::load(unsigned int index, SequencePattern *pattern) {
+    const patternFileEntry *entry = _entry(index, PATTERN_FILE_SEQUENCE);
+    if ((entry == NULL) || (pattern == NULL)) {
+        return false;
+    }
+    pattern->setName(entry->name);
+    pattern->setSequence((const sequencePoint *)(_data + entry->offset), entry->count);
+    return true;
+}
+
+bool PatternFile::load(unsigned int index, SequencePlayer *pattern) {
+    const patternFileEntry *entry = _entry(index, PATTERN_FILE_MOTION);
+    if ((entry == NULL) || (pattern == NULL)) {
+        return false;
+    }
+    pattern->setName(entry->name);
+    pattern->setMoves((const plannedMove *)(_data + entry->offset), entry->count);
+    return true;
+}
+
+const patternFileEntry *PatternFile::_entry(unsigned int index, uint16_t type) {
+    if ((index >= count()) || (_entries[index].type != type)) {
+        return NULL;
+    }
+    return &_entries[index];
+}
+
+bool PatternFile::_validate() {
+    // Header, directory and sequences are read in place and must be aligned
+    if ((_data == NULL) || (_size < sizeof(patternFileHeader)) || ((uintptr_t(_data) % 4) != 0)) {
+        return false;
+    }
+
+    const patternFileHeader *header = (const patternFileHeader *)_data;
+    if ((memcmp(header->magic, PATTERN_FILE_MAGIC, 4) != 0) || (header->version != PATTERN_FILE_VERSION)) {
+        return false;
+    }
+
+    // The mapped area may be larger than the file, but never smaller
+    if ((header->size > _size) || (header->size < sizeof(patternFileHeader) + header->entries * sizeof(patternFileEntry))) {
+        return false;
+    }
+
+    const patternFileEntry *entries = (const patternFileEntry *)(_data + sizeof(patternFileHeader));
+    for (unsigned int i = 0; i < header->entries; i++) {
+        size_t elementSize = 0;
+        if (entries[i].type == PATTERN_FILE_KEYFRAMES) {
+            elementSize = sizeof(keyframe);
+        } else if (entries[i].type == PATTERN_FILE_SEQUENCE) {
+            elementSize = sizeof(sequencePoint);
+        } else if (entries[i].type == PATTERN_FILE_MOTION) {
+            elementSize = sizeof(plannedMove);
+        } else {
+            return false;
+        }
+
+        // Names must be terminated, data must be aligned and inside of the file
+        if (memchr(entries[i].name, '\0', PATTERN_FILE_NAME_LEN) == NULL) {
+            return false;
+        }
+        if (((entries[i].offset % 4) != 0) || (entries[i].offset > header->size) ||
+            (size_t(entries[i].count) * elementSize > header->size - entries[i].offset)) {
+            return false;
+        }
+    }
+
+    _header = header;
+    _entries = entries;
+    return true;
+}
@@ -0,0 +1,124 @@
+/**
+ *   Binary Pattern Files of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pattern.h"
+#include "PatternFileFormat.h"
+
+
+/**************************************************************************/
+/*!
+  @class PatternFile
+  @brief  Read access to a binary pattern file holding any number of keyframe
+          tables and recorded sequences. The file is validated once when it is
+          opened and then used in place: patterns point directly into the
+          mapped file, nothing is parsed into heap structures. On target the
+          file is stored in a data partition and mapped into the address
+          space with esp_partition_mmap(). The host build maps a file with
+          mmap(). A file can also be linked into the firmware as a byte array.
+
+          Layout: patternFileHeader, patternFileEntry[entries], data.
+          Keyframes are stored as keyframe (5 bytes), sequences as
+          sequencePoint (4 bytes) in the format of pattern.h, compiled 
+          scripts as plannedMove (12 bytes) of MotionPlanner.h.
+*/
+/**************************************************************************/
+class PatternFile {
+
+    public:
+        ~PatternFile() { close(); }
+
+        //! Use a pattern file already in memory, e.g. a const array in flash
+        /*!
+          @param data pointer to the file, 4 byte aligned. Must stay valid while the file is open.
+          @param size size of the file in bytes
+          @return true if the file is valid, false otherwise
+        */
+        bool openBuffer(const void *data, size_t size);
+
+#ifdef STROKEENGINE_HOST_SIMULATION
+        //! Map a pattern file from the file system
+        /*!
+          @param path path of the file
+          @return true if the file could be mapped and is valid, false otherwise
+        */
+        bool openFile(const char *path);
+#else
+        //! Map a pattern file from a data partition in flash
+        /*!
+          @param label label of the data partition in the partition table
+          @return true if the partition could be mapped and holds a valid file, false otherwise
+        */
+        bool openPartition(const char *label);
+#endif
+
+        //! Release the file. Patterns loaded from it must not be used afterwards.
+        void close();
+
+        //! Number of entries in the file
+        /*!
+          @return number of entries, 0 if no valid file is open
+        */
+        unsigned int count() { return _header ? _header->entries : 0; }
+
+        //! Name of an entry
+        /*!
+          @param index index of the entry
+          @return name, NULL if index is out of range
+        */
+        const char *getName(unsigned int index);
+
+        //! Kind of data of an entry
+        /*!
+          @param index index of the entry
+          @return patternFileSection of the entry, 0 if index is out of range
+        */
+        uint16_t getType(unsigned int index);
+
+        //! Point a KeyframePattern to a keyframe table of the file. Takes over the entry name.
+        //! Tables longer than KEYFRAME_CACHE_SIZE are truncated.
+        /*!
+          @param index index of the entry
+          @param pattern pattern to load. Should not be the active pattern while loading.
+          @return true on success, false if index is out of range or not a keyframe table
+        */
+        bool load(unsigned int index, KeyframePattern *pattern);
+
+        //! Point a SequencePattern to a recorded sequence of the file. Takes over the entry name.
+        /*!
+          @param index index of the entry
+          @param pattern pattern to load. Should not be the active pattern while loading.
+          @return true on success, false if index is out of range or not a sequence
+        */
+        bool load(unsigned int index, SequencePattern *pattern);
+
+        //! Point a SequencePlayer to a compiled motion stream of the file. Takes over the entry name.
+        /*!
+          @param index index of the entry
+          @param pattern pattern to load. Should not be the active pattern while loading.
+          @return true on success, false if index is out of range or not a motion stream
+        */
+        bool load(unsigned int index, SequencePlayer *pattern);
+
+    protected:
+        const uint8_t *_data = NULL;
+        const patternFileHeader *_header = NULL;
+        const patternFileEntry *_entries = NULL;
+        size_t _size = 0;
+        void *_mapping = NULL;              // host: address returned by mmap()
+        uint32_t _mappingHandle = 0;        // target: handle of esp_partition_mmap()
+        bool _mapped = false;
+        bool _validate();
+        const patternFileEntry *_entry(unsigned int index, uint16_t type);
+};
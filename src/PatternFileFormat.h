@@ -0,0 +1,58 @@
+/**
+ *   Binary Pattern File Format of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ * Free of any Arduino dependency, so host tools can write pattern files.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define PATTERN_FILE_MAGIC      "SEPF"    // First 4 bytes of every pattern file
+#define PATTERN_FILE_VERSION    1         // Version this library reads
+#define PATTERN_FILE_NAME_LEN   24        // Bytes reserved for an entry name including the terminating zero
+
+/**************************************************************************/
+/*!
+  @brief  Kind of data an entry of a pattern file holds.
+*/
+/**************************************************************************/
+typedef enum {
+  PATTERN_FILE_KEYFRAMES = 1,   //!< Table of keyframe for a KeyframePattern
+  PATTERN_FILE_SEQUENCE = 2,    //!< Recorded sequence of sequencePoint for a SequencePattern
+  PATTERN_FILE_MOTION = 3       //!< Compiled stream of plannedMove for a SequencePlayer
+} patternFileSection;
+
+/**************************************************************************/
+/*!
+  @brief  File header, 16 bytes at offset 0. All numbers are little endian
+  like the ESP32 itself, so the file is used as is.
+*/
+/**************************************************************************/
+typedef struct {
+    char magic[4];              //!< PATTERN_FILE_MAGIC
+    uint16_t version;           //!< PATTERN_FILE_VERSION
+    uint16_t entries;           //!< Number of directory entries following the header
+    uint32_t size;              //!< Total size of the file in bytes
+    uint32_t reserved;          //!< 0
+} patternFileHeader;
+
+/**************************************************************************/
+/*!
+  @brief  Directory entry, 32 bytes. The directory follows the header
+  directly. Data of an entry starts at a 4 byte aligned offset.
+*/
+/**************************************************************************/
+typedef struct {
+    char name[PATTERN_FILE_NAME_LEN];   //!< Zero terminated name of the pattern
+    uint16_t type;                      //!< patternFileSection
+    uint16_t count;                     //!< Number of keyframes, sequence points or planned moves
+    uint32_t offset;                    //!< Offset of the data from the start of the file
+} patternFileEntry;
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <math.h>
+#include <stdint.h>
 #include <Arduino.h>
 
+#define FIXED_SHIFT     16                  // Fractional bits of fixed_t
+#define FIXED_ONE       (1 << FIXED_SHIFT)  // 1.0 as fixed_t
+
+//! Signed Q16.16 fixed point number. Range ±32767 with a resolution of 1.5e-5.
+typedef int32_t fixed_t;
+
 
 /**************************************************************************/
 /*!
@@ -28,6 +35,8 @@
                      Parameters are from -10 to 10 with 0 being a linear mapping 
                      (which basically takes curve out of the equation)
   @returns the scaled value
+  @note A curve of 0 takes a linear fast path without any pow(). Other curves
+  use single precision powf(), as the ESP32 has no FPU for double.
 */
 /**************************************************************************/
 inline float fscale( float originalMin, float originalMax, float newBegin, float
@@ -46,8 +55,13 @@ newEnd, float inputValue, float curve){
   if (curve > 10) curve = 10;
   if (curve < -10) curve = -10;
 
-  curve = (curve * -.1) ; // - invert and scale - this seems more intuitive - positive numbers give more weight to high end on output
-  curve = pow(10, curve); // convert linear scale into logarithmic exponent for other pow function
+  // Linear mapping needs no exponent, all built-in patterns end up here
+  bool linear = (curve == 0.0f);
+
+  if (!linear) {
+    curve = (curve * -0.1f) ; // - invert and scale - this seems more intuitive - positive numbers give more weight to high end on output
+    curve = powf(10.0f, curve); // convert linear scale into logarithmic exponent for other pow function
+  }
 
   // Check for out of range inputValues
   if (inputValue < originalMin) {
@@ -77,13 +91,17 @@ newEnd, float inputValue, float curve){
     return 0;
   }
 
+  if (!linear) {
+    normalizedCurVal = powf(normalizedCurVal, curve);
+  }
+
   if (invFlag == 0){
-    rangedValue =  (pow(normalizedCurVal, curve) * NewRange) + newBegin;
+    rangedValue =  (normalizedCurVal * NewRange) + newBegin;
 
   }
   else     // invert the ranges
   {  
-    rangedValue =  newBegin - (pow(normalizedCurVal, curve) * NewRange);
+    rangedValue =  newBegin - (normalizedCurVal * NewRange);
   }
 
   return rangedValue;
@@ -137,4 +155,98 @@ inline float mapSensationToFactor(float maximumFactor, float inputValue, float c
     
 }
 
+/**************************************************************************/
+/*!
+  @brief  Converts a float into a Q16.16 fixed point number. Rounds to the
+  nearest value and saturates outside of the representable range.
+  @param value  value to convert
+  @returns fixed point value
+*/
+/**************************************************************************/
+inline fixed_t floatToFixed(float value) {
+    float scaled = value * FIXED_ONE;
+    if (scaled >= 2147483647.0f) {
+        return INT32_MAX;
+    }
+    if (scaled <= -2147483648.0f) {
+        return INT32_MIN;
+    }
+    return fixed_t((scaled >= 0.0f) ? (scaled + 0.5f) : (scaled - 0.5f));
+}
+
+/**************************************************************************/
+/*!
+  @brief  Converts a Q16.16 fixed point number into a float.
+  @param value  fixed point value to convert
+  @returns float value
+*/
+/**************************************************************************/
+inline float fixedToFloat(fixed_t value) {
+    return float(value) / FIXED_ONE;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Multiplies an integer with a Q16.16 factor. Truncates towards 
+  zero like int() does on a float.
+  @param value  integer value, e.g. a distance in steps
+  @param factor Q16.16 factor
+  @returns integer product
+*/
+/**************************************************************************/
+inline int fixedMultiply(int value, fixed_t factor) {
+    return int((int64_t(value) * factor) / FIXED_ONE);
+}
+
+/**************************************************************************/
+/*!
+  @class TrapezoidProfile
+  @brief  Speed and acceleration of a trapezoidal move that has to cover a 
+  distance in a given time. The move accelerates for a share x of the time,
+  coasts and decelerates for the same share x again. Thus
+  speed = distance / ((1 - x) * time) and acceleration = speed / (x * time).
+  Both factors are precomputed as Q16.16 whenever the time or the share
+  changes. Per move only an integer multiplication remains, no division and
+  no float or double math. 
+  The relative deviation from the float calculation is at most 2^-17 / factor
+  plus truncation. That is below 1e-4 for moves shorter than 10s and below 
+  5e-4 for moves up to 60s. Results are truncated like int().
+*/
+/**************************************************************************/
+class TrapezoidProfile {
+
+  public:
+    //! Precompute the factors of the profile
+    /*!
+      @param time              time the move takes in [s]
+      @param accelerationShare share of the time spent accelerating. 
+                               1/3 gives a 1/3 accelerate, 1/3 coast, 1/3 decelerate profile.
+    */
+    void setTime(float time, float accelerationShare = 1.0f/3.0f) {
+      if ((time <= 0.0f) || (accelerationShare <= 0.0f) || (accelerationShare >= 1.0f)) {
+        _speedFactor = 0;
+        _accelerationFactor = 0;
+        return;
+      }
+      _speedFactor = floatToFixed(1.0f / ((1.0f - accelerationShare) * time));
+      _accelerationFactor = floatToFixed(1.0f / (accelerationShare * time));
+    }
 
+    //! Maximum speed of the move
+    /*!
+      @param distance distance to travel in [steps]
+      @returns speed in [steps/s]
+    */
+    int speed(int distance) { return fixedMultiply(distance, _speedFactor); }
+
+    //! Acceleration of the move
+    /*!
+      @param speed maximum speed as returned by speed() in [steps/s]
+      @returns acceleration in [steps/s²]
+    */
+    int acceleration(int speed) { return fixedMultiply(speed, _accelerationFactor); }
+
+  protected:
+    fixed_t _speedFactor = 0;
+    fixed_t _accelerationFactor = 0;
+};
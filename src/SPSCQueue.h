@@ -0,0 +1,146 @@
+/**
+ *   Lock-free Single-Producer/Single-Consumer Queue of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+
+/**************************************************************************/
+/*!
+  @class SPSCQueue
+  @brief  Bounded lock-free ring buffer for exactly one producer task and
+          one consumer task. Elements are stored by value in a static array,
+          so no heap is used. Neither side ever blocks or waits for the
+          other, which allows e.g. a network task on core 0 to feed the
+          motion task on core 1 without any mutex.
+          Producer side: push(), flush(), available()
+          Consumer side: pop(), peek(), isEmpty(), size()
+  @tparam T Element type, must be copy assignable
+  @tparam N Capacity in elements, must be a power of two so the free running
+          indices stay consistent when they wrap around
+*/
+/**************************************************************************/
+template <typename T, size_t N>
+class SPSCQueue {
+
+    static_assert((N > 0) && ((N & (N - 1)) == 0), "SPSCQueue capacity must be a power of two");
+
+    public:
+        //! Append a single element.
+        /*!
+          @param item element to append
+          @return true on success, false if the queue is full and the element was dropped
+        */
+        bool push(const T &item) {
+            return push(&item, 1) == 1;
+        }
+
+        //! Append a batch of elements with a single update of the write index.
+        /*!
+          @param items pointer to the first of count elements
+          @param count number of elements to append
+          @return number of elements accepted. Less than count if the queue ran full.
+        */
+        size_t push(const T *items, size_t count) {
+            size_t head = _head.load(std::memory_order_relaxed);
+            size_t tail = _tail.load(std::memory_order_acquire);
+            size_t free = N - (head - tail);
+            if (count > free) {
+                count = free;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                _buffer[(head + i) & (N - 1)] = items[i];
+            }
+
+            // publish all elements at once
+            _head.store(head + count, std::memory_order_release);
+            return count;
+        }
+
+        //! Discard all elements pushed so far. Elements pushed afterwards are kept.
+        //! The consumer drops the discarded elements on its next access.
+        void flush() {
+            _flushHead.store(_head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            _flushPending.store(true, std::memory_order_release);
+        }
+
+        //! Number of free slots as seen by the producer
+        /*!
+          @return free slots
+        */
+        size_t available() {
+            return N - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+        }
+
+        //! Remove the oldest element
+        /*!
+          @param item receives the element
+          @return true on success, false if the queue is empty
+        */
+        bool pop(T &item) {
+            if (peek(item) == false) {
+                return false;
+            }
+            _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            return true;
+        }
+
+        //! Read the oldest element without removing it
+        /*!
+          @param item receives the element
+          @return true on success, false if the queue is empty
+        */
+        bool peek(T &item) {
+            _applyFlush();
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = _buffer[tail & (N - 1)];
+            return true;
+        }
+
+        //! Whether the queue is empty as seen by the consumer
+        bool isEmpty() {
+            _applyFlush();
+            return _tail.load(std::memory_order_relaxed) == _head.load(std::memory_order_acquire);
+        }
+
+        //! Number of elements as seen by the consumer
+        size_t size() {
+            _applyFlush();
+            return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+        }
+
+        //! Capacity of the queue
+        static constexpr size_t capacity() { return N; }
+
+    protected:
+        T _buffer[N];
+        std::atomic<size_t> _head{0};           // written by the producer only
+        std::atomic<size_t> _tail{0};           // written by the consumer only
+        std::atomic<size_t> _flushHead{0};      // write index at the time of the last flush()
+        std::atomic<bool> _flushPending{false};
+
+        // Consumer side of flush(): skip everything written before the flush.
+        // The read index only ever moves forward.
+        void _applyFlush() {
+            if (_flushPending.exchange(false, std::memory_order_acquire)) {
+                size_t flushHead = _flushHead.load(std::memory_order_relaxed);
+                size_t tail = _tail.load(std::memory_order_relaxed);
+                if ((long)(flushHead - tail) > 0) {
+                    _tail.store(flushHead, std::memory_order_release);
+                }
+            }
+        }
+};
@@ -0,0 +1,72 @@
+/**
+ *   Sequence Lock of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+/**************************************************************************/
+/*!
+  @class SeqLock
+  @brief  Publishes a small block of data from one writer to any number of
+          readers without a mutex. The writer never waits. A reader copies
+          the block and retries only if a write happened during its copy,
+          which takes a few hundred nanoseconds at most. The sequence number
+          tells a reader whether anything changed since its last copy.
+          Writer side: write(). Concurrent writers must be serialized by the
+          caller, e.g. with a critical section.
+          Reader side: read(), sequence()
+  @tparam T Data type, must be trivially copyable
+*/
+/**************************************************************************/
+template <typename T>
+class SeqLock {
+
+    public:
+        //! Publish a new block
+        /*!
+          @param data block to publish
+        */
+        void write(const T &data) {
+            // An odd sequence marks a write in progress
+            uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+            _sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            _data = data;
+            _sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        //! Copy the latest consistent block
+        /*!
+          @param data receives the block
+          @return sequence number of the copied block
+        */
+        uint32_t read(T &data) const {
+            uint32_t before, after;
+            do {
+                before = _sequence.load(std::memory_order_acquire);
+                data = _data;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = _sequence.load(std::memory_order_relaxed);
+            } while ((before != after) || (before & 1));
+            return before;
+        }
+
+        //! Sequence number of the latest block, changes with every write()
+        uint32_t sequence() const {
+            return _sequence.load(std::memory_order_acquire) & ~uint32_t(1);
+        }
+
+    protected:
+        T _data;
+        std::atomic<uint32_t> _sequence{0};
+};
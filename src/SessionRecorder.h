@@ -0,0 +1,161 @@
+/**
+ *   Session Recorder of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ * Free of any Arduino dependency, so host tools can read recorded sessions.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SESSION_FILE_MAGIC      "SESR"    // First 4 bytes of every session file
+#define SESSION_FILE_VERSION    1         // Version this library writes and reads
+
+#ifndef SESSION_RECORDER_DEPTH
+  #define SESSION_RECORDER_DEPTH  256     // Events the session recorder keeps. Must be a power of two.
+#endif
+
+/**************************************************************************/
+/*!
+  @brief  Kind of a recorded event and the meaning of its payload. Floats are
+  stored bit by bit with sessionFromFloat(). Positions, speeds, accelerations
+  and jerks are in steps like inside the StrokeEngine.
+*/
+/**************************************************************************/
+typedef enum {
+  SESSION_SET_SPEED = 1,          //!< setSpeed(): data[0] strokes per minute
+  SESSION_SET_DEPTH = 2,          //!< setDepth(): data[0] depth in mm
+  SESSION_SET_STROKE = 3,         //!< setStroke(): data[0] stroke in mm
+  SESSION_SET_SENSATION = 4,      //!< setSensation(): data[0] sensation
+  SESSION_SET_PATTERN = 5,        //!< setPattern(): index pattern index
+  SESSION_SET_MAX_SPEED = 6,      //!< setMaxSpeed(): data[0] speed in mm/s
+  SESSION_SET_MAX_ACCELERATION = 7, //!< setMaxAcceleration(): data[0] acceleration in mm/s²
+  SESSION_SET_MAX_JERK = 8,       //!< setMaxJerk(): data[0] jerk in mm/s³
+  SESSION_STREAM_POINT = 9,       //!< appendToStreaming(): index position in %, data[0] time or timestamp in ms
+  SESSION_SYNC_CLOCK = 10,        //!< syncStreamingClock(): data[0] timestamp, data[1] resulting clock offset in ms
+  SESSION_LIMITS = 11,            //!< Precedes every start: index position, data[0] speed, data[1] 
+                                  //!< acceleration and data[2] jerk limit
+  SESSION_START_PATTERN = 12,     //!< startPattern(): index pattern index, data[0] depth, data[1] stroke, 
+                                  //!< data[2] time of stroke in s, data[3] sensation
+  SESSION_START_STREAMING = 13,   //!< startStreaming(): payload like SESSION_START_PATTERN
+  SESSION_STOP = 14,              //!< stopMotion(): index position
+  SESSION_AXIS = 15,              //!< Axis state a streaming move is planned from: data[0] position, 
+                                  //!< data[1] speed, data[2] millis()
+  SESSION_COMPUTE = 16,           //!< Result of nextTarget(): index stroke index, data[0] stroke, 
+                                  //!< data[1] speed, data[2] acceleration, data[3] jerk
+  SESSION_MOVE = 17               //!< Move handed to the stepper: index stroke index, payload like 
+                                  //!< SESSION_COMPUTE before clipping, flags telemetryClipping
+} sessionEventType;
+
+/**************************************************************************/
+/*!
+  @brief  Flags of sessionEvent.flags. Their meaning depends on the event.
+*/
+/**************************************************************************/
+typedef enum {
+  SESSION_FLAG_APPLY_NOW = 0x01,  //!< Setters: applyNow was true
+  SESSION_FLAG_REPLACE = 0x01,    //!< SESSION_STREAM_POINT: replace was true
+  SESSION_FLAG_ABSOLUTE = 0x02,   //!< SESSION_STREAM_POINT: data[0] is a timestamp
+  SESSION_FLAG_SKIP = 0x01        //!< SESSION_COMPUTE: the pattern requested a pause
+} sessionEventFlags;
+
+/**************************************************************************/
+/*!
+  @brief  A single recorded event, 28 bytes.
+*/
+/**************************************************************************/
+typedef struct {
+    uint32_t timestamp;         //!< micros() when the event happened
+    uint8_t type;               //!< sessionEventType
+    uint8_t flags;              //!< sessionEventFlags
+    uint16_t reserved;          //!< 0
+    int32_t index;              //!< Stroke index, pattern index or position, see sessionEventType
+    int32_t data[4];            //!< Payload, see sessionEventType
+} sessionEvent;
+
+/**************************************************************************/
+/*!
+  @brief  Header of a session file, 32 bytes. The events follow oldest
+  first. All numbers are little endian like the ESP32 itself.
+*/
+/**************************************************************************/
+typedef struct {
+    char magic[4];              //!< SESSION_FILE_MAGIC
+    uint16_t version;           //!< SESSION_FILE_VERSION
+    uint16_t reserved;          //!< 0
+    uint32_t count;             //!< Number of events following the header
+    float stepsPerMillimeter;   //!< motorProperties of the recording machine
+    float physicalTravel;       //!< machineGeometry of the recording machine
+    float keepoutBoundary;
+    float maxSpeed;
+    float maxAcceleration;
+} sessionFileHeader;
+
+//! Store a float in an event payload without conversion
+inline int32_t sessionFromFloat(float value) {
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+//! Read a float stored with sessionFromFloat()
+inline float sessionToFloat(int32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**************************************************************************/
+/*!
+  @class SessionRecorder
+  @brief  Flight recorder for the events of a session. A ring of
+          SESSION_RECORDER_DEPTH events in a static array, so it never
+          allocates. When full the oldest event is overwritten, so the
+          recorder always holds the events leading up to now. Not thread
+          safe, callers writing from several tasks must serialize.
+*/
+/**************************************************************************/
+class SessionRecorder {
+
+    static_assert((SESSION_RECORDER_DEPTH & (SESSION_RECORDER_DEPTH - 1)) == 0, 
+        "SESSION_RECORDER_DEPTH must be a power of two");
+
+    public:
+        //! Append an event, overwriting the oldest one if full
+        void record(const sessionEvent &event) {
+            _events[_head] = event;
+            _head = (_head + 1) & (SESSION_RECORDER_DEPTH - 1);
+            if (_count < SESSION_RECORDER_DEPTH) {
+                _count++;
+            }
+        }
+
+        //! Number of events held
+        size_t size() const { return _count; }
+
+        //! Event by age
+        /*!
+          @param index 0 for the oldest event up to size() - 1 for the newest
+          @return the event
+        */
+        const sessionEvent &get(size_t index) const {
+            return _events[(_head - _count + index) & (SESSION_RECORDER_DEPTH - 1)];
+        }
+
+        //! Discard all events
+        void clear() { _head = 0; _count = 0; }
+
+    protected:
+        sessionEvent _events[SESSION_RECORDER_DEPTH];
+        size_t _head = 0;               // Slot the next event is written to
+        size_t _count = 0;              // Events held, at most SESSION_RECORDER_DEPTH
+};
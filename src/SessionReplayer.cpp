@@ -0,0 +1,205 @@
+#include "SessionReplayer.h"
+
+static_assert(sizeof(sessionFileHeader) == 32, "Session file header must be 32 bytes");
+static_assert(sizeof(sessionEvent) == 28, "Session event must be 28 bytes");
+
+bool SessionReplayer::open(const void *data, size_t size) {
+    _session = NULL;
+    _events = NULL;
+
+    if ((data == NULL) || (size < sizeof(sessionFileHeader)) || ((uintptr_t(data) % 4) != 0)) {
+        return false;
+    }
+
+    const sessionFileHeader *header = (const sessionFileHeader *)data;
+    if ((memcmp(header->magic, SESSION_FILE_MAGIC, 4) != 0) || (header->version != SESSION_FILE_VERSION)) {
+        return false;
+    }
+    if (header->count > (size - sizeof(sessionFileHeader)) / sizeof(sessionEvent)) {
+        return false;
+    }
+
+    _session = header;
+    _events = (const sessionEvent *)((const uint8_t *)data + sizeof(sessionFileHeader));
+    return true;
+}
+
+sessionReplayResult SessionReplayer::replay(bool verbose) {
+    sessionReplayResult result = {0, 0, 0, 0, 0, 0, -1, 0};
+    if (_session == NULL) {
+        return result;
+    }
+
+    // Same machine as recorded, homed and with a fresh simulated stepper
+    _replayGeometry.physicalTravel = _session->physicalTravel;
+    _replayGeometry.keepoutBoundary = _session->keepoutBoundary;
+    _replayMotor.maxSpeed = _session->maxSpeed;
+    _replayMotor.maxAcceleration = _session->maxAcceleration;
+    _replayMotor.stepsPerMillimeter = _session->stepsPerMillimeter;
+    _replayMotor.invertDirection = false;
+    _replayMotor.enableActiveLow = false;
+    _replayMotor.stepPin = -1;
+    _replayMotor.directionPin = -1;
+    _replayMotor.enablePin = -1;
+    _replayStepper = VirtualStepper();
+    begin(&_replayGeometry, &_replayMotor, &_replayStepper);
+    _replayStepper.enableOutputs();
+    _isHomed = true;
+    _state = READY;
+
+    // Everything before the first start depends on state that is no longer recorded
+    uint32_t count = _session->count;
+    uint32_t first = count;
+    for (uint32_t i = 1; i < count; i++) {
+        if (((_events[i].type == SESSION_START_PATTERN) || (_events[i].type == SESSION_START_STREAMING)) &&
+            (_events[i - 1].type == SESSION_LIMITS)) {
+            first = i - 1;
+            break;
+        }
+    }
+
+    uint32_t previous = (first < count) ? _events[first].timestamp : 0;
+    for (uint32_t i = first; i < count; i++) {
+        const sessionEvent &event = _events[i];
+        bool applyNow = (event.flags & SESSION_FLAG_APPLY_NOW) != 0;
+        bool diverged = false;
+
+        // Let the simulated axis move as long as the real one did
+        _replayStepper.advance(event.timestamp - previous);
+        previous = event.timestamp;
+        result.events++;
+
+        switch (event.type) {
+            case SESSION_SET_SPEED:
+                setSpeed(sessionToFloat(event.data[0]), applyNow);
+                break;
+            case SESSION_SET_DEPTH:
+                setDepth(sessionToFloat(event.data[0]), applyNow);
+                break;
+            case SESSION_SET_STROKE:
+                setStroke(sessionToFloat(event.data[0]), applyNow);
+                break;
+            case SESSION_SET_SENSATION:
+                setSensation(sessionToFloat(event.data[0]), applyNow);
+                break;
+            case SESSION_SET_PATTERN:
+                setPattern(event.index, applyNow);
+                break;
+            case SESSION_SET_MAX_SPEED:
+                setMaxSpeed(sessionToFloat(event.data[0]));
+                break;
+            case SESSION_SET_MAX_ACCELERATION:
+                setMaxAcceleration(sessionToFloat(event.data[0]));
+                break;
+            case SESSION_SET_MAX_JERK:
+                setMaxJerk(sessionToFloat(event.data[0]));
+                break;
+
+            case SESSION_STREAM_POINT: {
+                Movement movement(event.index, event.data[0], (event.flags & SESSION_FLAG_ABSOLUTE) != 0);
+                appendToStreaming(&movement, 1, (event.flags & SESSION_FLAG_REPLACE) != 0);
+                break;
+            }
+            case SESSION_SYNC_CLOCK:
+                livePosition->setClockOffset(event.data[1]);
+                break;
+
+            case SESSION_LIMITS:
+                // The simulated axis starts where the real one was
+                _maxStepPerSecond = event.data[0];
+                _maxStepAcceleration = event.data[1];
+                _maxStepJerk = event.data[2];
+                _publishSettings(false);
+                _replayStepper.forceStopAndNewPosition(event.index);
+                break;
+
+            case SESSION_START_PATTERN:
+            case SESSION_START_STREAMING:
+                _patternIndex = event.index;
+                _depth = event.data[0];
+                _stroke = event.data[1];
+                _timeOfStroke = sessionToFloat(event.data[2]);
+                _sensation = sessionToFloat(event.data[3]);
+                _publishSettings(false);
+                _applyUpdate = false;
+                if (event.type == SESSION_START_PATTERN) {
+                    _state = PATTERN;
+                    _preparePattern();
+                } else {
+                    _state = STREAMING;
+                    _prepareStreaming();
+                }
+                break;
+
+            case SESSION_STOP:
+                // Like stopMotion(), without waiting for a standstill that only comes with advance()
+                _state = READY;
+                _replayStepper.setAcceleration(_maxStepAcceleration);
+                _replayStepper.applySpeedAcceleration();
+                _replayStepper.stopMove();
+                break;
+
+            case SESSION_AXIS: {
+                // Plan from the recorded axis, the simulation only approximates the real one
+                livePosition->setActualState(event.data[0], event.data[1], (unsigned long)event.data[2]);
+                int32_t error = abs(event.data[0] - _replayStepper.getCurrentPosition());
+                if (error > result.maxAxisError) {
+                    result.maxAxisError = error;
+                }
+                break;
+            }
+
+            case SESSION_COMPUTE: {
+                // The motion task takes over published parameters before it computes
+                _applySettings();
+                motionParameter motion = _computeMotion(event.index);
+                result.computes++;
+                if ((motion.skip != ((event.flags & SESSION_FLAG_SKIP) != 0)) || (motion.stroke != event.data[0]) || 
+                    (motion.speed != event.data[1]) || (motion.acceleration != event.data[2]) || (motion.jerk != event.data[3])) {
+                    result.computeMismatches++;
+                    diverged = true;
+                    if (verbose) {
+                        Serial.printf("Event %u: stroke %d computed %d, %d, %d, %d instead of %d, %d, %d, %d\n",
+                            unsigned(i), int(event.index), motion.stroke, motion.speed, motion.acceleration, motion.jerk,
+                            int(event.data[0]), int(event.data[1]), int(event.data[2]), int(event.data[3]));
+                    }
+                }
+                break;
+            }
+
+            case SESSION_MOVE: {
+                motionParameter motion;
+                motion.stroke = event.data[0];
+                motion.speed = event.data[1];
+                motion.acceleration = event.data[2];
+                motion.jerk = event.data[3];
+                motion.skip = false;
+                _index = event.index;
+                uint8_t clipping = _applyMotionProfile(&motion);
+                result.moves++;
+                if (clipping != 0) {
+                    result.clippedMoves++;
+                }
+                if (clipping != event.flags) {
+                    result.clipMismatches++;
+                    diverged = true;
+                    if (verbose) {
+                        Serial.printf("Event %u: stroke %d clipped with flags 0x%02x instead of 0x%02x\n",
+                            unsigned(i), int(event.index), clipping, event.flags);
+                    }
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        if (diverged && (result.firstMismatch < 0)) {
+            result.firstMismatch = i;
+        }
+    }
+
+    _state = READY;
+    return result;
+}
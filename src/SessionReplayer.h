@@ -0,0 +1,80 @@
+/**
+ *   Session Replayer of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <StrokeEngine.h>
+#include "SessionRecorder.h"
+#include "VirtualStepper.h"
+
+/**************************************************************************/
+/*!
+  @brief  Outcome of SessionReplayer::replay()
+*/
+/**************************************************************************/
+typedef struct {
+  uint32_t events;            /*> Events replayed */
+  uint32_t computes;          /*> Moves computed by the pattern again */
+  uint32_t computeMismatches; /*> Computed moves differing from the recording */
+  uint32_t moves;             /*> Moves handed to the simulated stepper */
+  uint32_t clippedMoves;      /*> Moves clipped on replay */
+  uint32_t clipMismatches;    /*> Moves clipped differently than recorded */
+  int32_t firstMismatch;      /*> Index of the first diverging event in the session, -1 if none */
+  int32_t maxAxisError;       /*> Largest distance in steps between the simulated and the recorded 
+                               *  axis a streaming move was planned from */
+} sessionReplayResult;
+
+/**************************************************************************/
+/*!
+  @class SessionReplayer
+  @brief  Re-runs a session exported by StrokeEngine::exportSession() through
+          the StrokeEngine code of this build with a VirtualStepper. Setter
+          calls and streamed points go through the real set-functions, every
+          recorded computation queries the pattern again with the same stroke
+          index, and every recorded move passes the real clipping. The motion
+          tasks are not involved: events are replayed one after another in
+          recorded order, so a replay is deterministic. Any pattern computing
+          a different move, or a move clipped differently, is reported. This
+          allows to bisect pattern regressions and clipping offline.
+
+          Replay starts at the first start of a pattern or streaming within
+          the session, as the state before it was overwritten in the ring.
+          Streamed points appended before that start are missing. Patterns 
+          depending on millis(), like Stop'n'Go, and parameter ramps set with
+          setRamp() will not replay exactly.
+*/
+/**************************************************************************/
+class SessionReplayer : public StrokeEngine {
+
+    public:
+        //! Use a session file in memory
+        /*!
+          @param data session file as written by exportSession(), 4 byte aligned. 
+                      Must stay valid during replay().
+          @param size size of the file in bytes
+          @return true if the file is a valid session, false otherwise
+        */
+        bool open(const void *data, size_t size);
+
+        //! Replay the session from the first start
+        /*!
+          @param verbose print every divergence on Serial
+          @return counts of replayed events and divergences
+        */
+        sessionReplayResult replay(bool verbose = false);
+
+    protected:
+        const sessionFileHeader *_session = NULL;
+        const sessionEvent *_events = NULL;
+        machineGeometry _replayGeometry;
+        motorProperties _replayMotor;
+        VirtualStepper _replayStepper;
+};
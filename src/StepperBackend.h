@@ -0,0 +1,128 @@
+/**
+ *   Stepper Backend of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**************************************************************************/
+/*!
+  @class StepperBackend
+  @brief  Interface between the StrokeEngine and the step generator. It
+          mirrors the subset of the FastAccelStepper API the StrokeEngine
+          uses, so the FastAccelStepper adapter is a thin pass-through.
+          Alternative implementations like the VirtualStepper allow to run
+          the StrokeEngine without any hardware attached.
+          All positions are in steps, speeds in steps/s and accelerations
+          in steps/s².
+*/
+/**************************************************************************/
+class StepperBackend {
+
+    public:
+        virtual ~StepperBackend() {}
+
+        //! Energize the motor driver
+        virtual void enableOutputs() = 0;
+
+        //! De-energize the motor driver
+        virtual void disableOutputs() = 0;
+
+        //! Set the top speed of the next move
+        /*!
+          @param speed speed in steps/s
+          @return 0 on success
+        */
+        virtual int8_t setSpeedInHz(uint32_t speed) = 0;
+
+        //! Set the acceleration and deceleration of the next move
+        /*!
+          @param acceleration acceleration in steps/s²
+          @return 0 on success
+        */
+        virtual int8_t setAcceleration(int32_t acceleration) = 0;
+
+        //! Limit the jerk of the next move. Acceleration ramps up linearly from
+        //! standstill over the given number of steps and ramps down the same way
+        //! when coming to a stop, which gives an S-curve profile.
+        /*!
+          @param steps length of the acceleration ramp in steps. 0 for a trapezoid.
+        */
+        virtual void setLinearAcceleration(uint32_t steps) = 0;
+
+        //! Apply speed and acceleration to a move that is already running
+        virtual void applySpeedAcceleration() = 0;
+
+        //! Start a move to an absolute position. A running move is re-planned.
+        /*!
+          @param position target position in steps
+          @return 0 on success
+        */
+        virtual int8_t moveTo(int32_t position) = 0;
+
+        //! Start a move relative to the current position
+        /*!
+          @param distance distance in steps, the sign gives the direction
+          @return 0 on success
+        */
+        virtual int8_t move(int32_t distance) = 0;
+
+        //! Run with the set speed towards positive positions until stopped
+        virtual int8_t runForward() = 0;
+
+        //! Run with the set speed towards negative positions until stopped
+        virtual int8_t runBackward() = 0;
+
+        //! Decelerate with the set acceleration until standstill
+        virtual void stopMove() = 0;
+
+        //! Stop immediately without deceleration and redefine the current position
+        /*!
+          @param position new current position in steps
+        */
+        virtual void forceStopAndNewPosition(int32_t position) = 0;
+
+        //! Redefine the current position
+        /*!
+          @param position new current position in steps
+        */
+        virtual void setCurrentPosition(int32_t position) = 0;
+
+        //! Whether a move is executed
+        /*!
+          @return true while the motor is moving
+        */
+        virtual bool isRunning() = 0;
+
+        //! Actual position of the motor
+        /*!
+          @return position in steps
+        */
+        virtual int32_t getCurrentPosition() = 0;
+
+        //! Actual speed of the motor
+        /*!
+          @return speed in steps/1000s, negative when moving towards negative positions
+        */
+        virtual int32_t getCurrentSpeedInMilliHz() = 0;
+
+        //! Top speed set with setSpeedInHz()
+        /*!
+          @return speed in steps/1000s
+        */
+        virtual uint32_t getSpeedInMilliHz() = 0;
+
+        //! Acceleration set with setAcceleration()
+        /*!
+          @return acceleration in steps/s²
+        */
+        virtual uint32_t getAcceleration() = 0;
+};
@@ -1,12 +1,58 @@
 #include <Arduino.h>
 #include <StrokeEngine.h>
-#include <FastAccelStepper.h>
 #include <pattern.h>
 
-FastAccelStepperEngine engine = FastAccelStepperEngine();
-FastAccelStepper *servo = NULL;
+#ifndef STROKEENGINE_HOST_SIMULATION
+#include <FastAccelStepperBackend.h>
 
+FastAccelStepperBackend fastAccelStepper;
+#endif
+
+StepperBackend *servo = NULL;
+
+// Serializes the tasks writing telemetry. Held for a few instructions only,
+// the consumer never takes it.
+static portMUX_TYPE telemetryMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Guards the hand-over of STOPPING and the pending move between the API and 
+// the task completing the stop
+static portMUX_TYPE stopMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Serializes the set-functions publishing a new parameter snapshot
+static portMUX_TYPE settingsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Statistics compile to nothing unless STROKEENGINE_STATS is defined
+#ifdef STROKEENGINE_STATS
+  #define STATS_START(start)              uint32_t start = micros()
+  #define STATS_SAMPLE(histogram, start)  _stats.histogram.add(micros() - (start))
+  #define STATS_COUNT(counter)            _stats.counter++
+#else
+  #define STATS_START(start)
+  #define STATS_SAMPLE(histogram, start)
+  #define STATS_COUNT(counter)
+#endif
+
+// Session recording compiles to nothing unless STROKEENGINE_RECORDER is defined
+#ifdef STROKEENGINE_RECORDER
+  #define RECORD(...)                     _record(__VA_ARGS__)
+
+// Serializes the tasks writing to the session recorder
+static portMUX_TYPE recorderMux = portMUX_INITIALIZER_UNLOCKED;
+#else
+  #define RECORD(...)
+#endif
+
+#ifndef STROKEENGINE_HOST_SIMULATION
 void StrokeEngine::begin(machineGeometry *physics, motorProperties *motor) {
+    // Setup FastAccelStepper 
+    fastAccelStepper.begin(motor->stepPin, motor->directionPin, motor->invertDirection, 
+        motor->enablePin, motor->enableActiveLow);
+
+    begin(physics, motor, &fastAccelStepper);
+}
+#endif
+
+void StrokeEngine::begin(machineGeometry *physics, motorProperties *motor, StepperBackend *backend) {
     // store the machine geometry and motor properties pointer
     _physics = physics;
     _motor = motor;
@@ -29,16 +75,13 @@ void StrokeEngine::begin(machineGeometry *physics, motorProperties *motor) {
     _previousStroke = _maxStep / 3;
     _timeOfStroke = 1.0;
     _sensation = 0.0;
+    _pendingMove = PENDING_NONE;
+    xEventGroupSetBits(_stopEvents, STOP_EVENT_IDLE);
+    _publishSettings(false);
 
-    // Setup FastAccelStepper 
-    engine.init();
-    servo = engine.stepperConnectToPin(_motor->stepPin);
-    if (servo) {
-        servo->setDirectionPin(_motor->directionPin, _motor->invertDirection);
-        servo->setEnablePin(_motor->enablePin, _motor->enableActiveLow);
-        servo->setAutoEnable(false);
-        servo->disableOutputs(); 
-    }
+    // Use the given step generator with disabled outputs
+    servo = backend;
+    servo->disableOutputs(); 
     Serial.println("Servo initialized");
 
 #ifdef DEBUG_TALKATIVE
@@ -47,33 +90,18 @@ void StrokeEngine::begin(machineGeometry *physics, motorProperties *motor) {
 }
 
 void StrokeEngine::setSpeed(float speed, bool applyNow = false) {
+    RECORD(SESSION_SET_SPEED, applyNow ? SESSION_FLAG_APPLY_NOW : 0, 0, sessionFromFloat(speed));
 
-    // Update pattern with new speed, will be used with the next stroke or on update request
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-
-        // Convert FPM into seconds to complete a full stroke
-        // Constrain stroke time between 10ms and 120 seconds
-        _timeOfStroke = constrain(60.0 / speed, 0.01, 120.0);
-
-        patternTable[_patternIndex]->setTimeOfStroke(_timeOfStroke);
+    // Convert FPM into seconds to complete a full stroke
+    // Constrain stroke time between 10ms and 120 seconds
+    float timeOfStroke = constrain(60.0 / speed, 0.01, 120.0);
 
 #ifdef DEBUG_TALKATIVE
-    Serial.println("setTimeOfStroke: " + String(_timeOfStroke, 2));
+    Serial.println("setTimeOfStroke: " + String(timeOfStroke, 2));
 #endif
 
-        // When running a pattern and immediate update requested: 
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
-
-#ifdef DEBUG_TALKATIVE
-        Serial.println("Apply New Settings Now");
-#endif
-        }
-
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
-    }
+    // Will be used with the next stroke or on update request
+    _publishSetting(_timeOfStroke, timeOfStroke, applyNow);
 }
 
 float StrokeEngine::getSpeed() {
@@ -82,34 +110,18 @@ float StrokeEngine::getSpeed() {
 }
 
 void StrokeEngine::setDepth(float depth, bool applyNow = false) {
+    RECORD(SESSION_SET_DEPTH, applyNow ? SESSION_FLAG_APPLY_NOW : 0, 0, sessionFromFloat(depth));
 
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-        // Convert depth from mm into steps
-        // Constrain depth between minStep and maxStep
-        _depth = constrain(int(depth * _motor->stepsPerMillimeter), _minStep, _maxStep); 
-
-        if (_state == PATTERN) {
-            patternTable[_patternIndex]->setDepth(_depth);
-        } else if (_state == STREAMING) {
-            livePosition->setDepth(_depth);
-        }
-
-#ifdef DEBUG_TALKATIVE
-        Serial.println("setDepth: " + String(_depth));
-#endif
-        // When running a pattern and immediate update requested: 
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
+    // Convert depth from mm into steps
+    // Constrain depth between minStep and maxStep
+    int depthStep = constrain(int(depth * _motor->stepsPerMillimeter), _minStep, _maxStep); 
 
 #ifdef DEBUG_TALKATIVE
-        Serial.println("Apply New Settings Now");
+    Serial.println("setDepth: " + String(depthStep));
 #endif
-        }
 
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
-    }
+    // Will be used with the next stroke or on update request
+    _publishSetting(_depth, depthStep, applyNow);
 
     // if in state SETUPDEPTH then adjust
     if (_state == SETUPDEPTH) {
@@ -123,36 +135,18 @@ float StrokeEngine::getDepth() {
 }
 
 void StrokeEngine::setStroke(float stroke, bool applyNow = false) {
-    // Update pattern with new stroke, will be used with the next stroke or on update request
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+    RECORD(SESSION_SET_STROKE, applyNow ? SESSION_FLAG_APPLY_NOW : 0, 0, sessionFromFloat(stroke));
 
-        // Convert stroke from mm into steps
-        // Constrain stroke between minStep and maxStep
-        _stroke = constrain(int(stroke * _motor->stepsPerMillimeter), _minStep, _maxStep); 
-
-        if (_state == PATTERN) {
-            patternTable[_patternIndex]->setStroke(_stroke);
-        } else if (_state == STREAMING) {
-            livePosition->setStroke(_stroke);
-        }
+    // Convert stroke from mm into steps
+    // Constrain stroke between minStep and maxStep
+    int strokeStep = constrain(int(stroke * _motor->stepsPerMillimeter), _minStep, _maxStep); 
 
 #ifdef DEBUG_TALKATIVE
-        Serial.println("setStroke: " + String(_stroke));
+    Serial.println("setStroke: " + String(strokeStep));
 #endif
-    
-        // When running a pattern and immediate update requested: 
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
 
-#ifdef DEBUG_TALKATIVE
-        Serial.println("Apply New Settings Now");
-#endif
-        }
-
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
-    }
+    // Will be used with the next stroke or on update request
+    _publishSetting(_stroke, strokeStep, applyNow);
 
     // if in state SETUPDEPTH then adjust
     if (_state == SETUPDEPTH) {
@@ -165,50 +159,92 @@ float StrokeEngine::getStroke() {
     return _stroke / _motor->stepsPerMillimeter;
 }
 
-void StrokeEngine::appendToStreaming(unsigned int position, unsigned int time, boolean replace) {
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-        if (replace) {
-            livePosition->clear();
-        }
-        livePosition->addPosition(position, time);
+bool StrokeEngine::appendToStreaming(unsigned int position, unsigned int time, boolean replace) {
+    RECORD(SESSION_STREAM_POINT, replace ? SESSION_FLAG_REPLACE : 0, position, time);
+
+    // Lock-free: the streaming buffer is a single-producer/single-consumer queue,
+    // so the producer never contends with the streaming task for _patternMutex
+    if (replace) {
+        livePosition->clear();
+    }
+    bool accepted = livePosition->addPosition(position, time);
 
 #ifdef DEBUG_TALKATIVE
-        Serial.println("appendToStreaming: " + String(position) + " " + String(time));
+    Serial.println("appendToStreaming: " + String(position) + " " + String(time));
 #endif
 
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
-    }
+    // Wake the streaming task in case it is idle and waiting for new points
+    _notifyMotionTask();
+
+    return accepted;
 }
 
-void StrokeEngine::setSensation(float sensation, bool applyNow = false) {
+bool StrokeEngine::appendToStreamingAt(unsigned int position, unsigned long timestamp, boolean replace) {
+    Movement movement(position, timestamp, true);
+    return appendToStreaming(&movement, 1, replace) == 1;
+}
 
-    // Update pattern with new sensation, will be used with the next stroke or on update request
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+size_t StrokeEngine::getStreamingFreeSlots() {
+    return livePosition->available();
+}
 
-        // Constrain sensation between -100 and 100
-        _sensation = constrain(sensation, -100, 100); 
+size_t StrokeEngine::getStreamingQueueDepth() {
+    return livePosition->capacity();
+}
 
-        patternTable[_patternIndex]->setSensation(_sensation);
+unsigned long StrokeEngine::getStreamingDropCount() {
+    return livePosition->dropped();
+}
+
+void StrokeEngine::syncStreamingClock(unsigned long timestamp) {
+    // Timestamp of the source corresponds to now
+    long offset = long(millis() - timestamp);
+    livePosition->setClockOffset(offset);
+    RECORD(SESSION_SYNC_CLOCK, 0, 0, int32_t(timestamp), int32_t(offset));
 
 #ifdef DEBUG_TALKATIVE
-        Serial.println("setSensation: " + String(_sensation));
+    Serial.println("syncStreamingClock: " + String(timestamp));
 #endif
+}
 
-        // When running a pattern and immediate update requested: 
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
+size_t StrokeEngine::appendToStreaming(const Movement *movements, size_t count, boolean replace) {
+#ifdef STROKEENGINE_RECORDER
+    for (size_t i = 0; i < count; i++) {
+        Movement movement = movements[i];
+        uint8_t flags = ((replace && (i == 0)) ? SESSION_FLAG_REPLACE : 0) | 
+            (movement.isAbsolute() ? SESSION_FLAG_ABSOLUTE : 0);
+        _record(SESSION_STREAM_POINT, flags, movement.position(), movement.time());
+    }
+#endif
+
+    if (replace) {
+        livePosition->clear();
+    }
+    size_t accepted = livePosition->addPositions(movements, count);
 
 #ifdef DEBUG_TALKATIVE
-        Serial.println("Apply New Settings Now");
+    Serial.println("appendToStreaming: " + String(accepted) + " of " + String(count) + " points");
 #endif
-        }
 
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
-    }
-    
+    // Wake the streaming task in case it is idle and waiting for new points
+    _notifyMotionTask();
+
+    return accepted;
+}
+
+void StrokeEngine::setSensation(float sensation, bool applyNow = false) {
+    RECORD(SESSION_SET_SENSATION, applyNow ? SESSION_FLAG_APPLY_NOW : 0, 0, sessionFromFloat(sensation));
+
+    // Constrain sensation between -100 and 100
+    sensation = constrain(sensation, -100, 100); 
+
+#ifdef DEBUG_TALKATIVE
+    Serial.println("setSensation: " + String(sensation));
+#endif
+
+    // Will be used with the next stroke or on update request
+    _publishSetting(_sensation, sensation, applyNow);
+
     // if in state SETUPDEPTH then adjust
     if (_state == SETUPDEPTH) {
         _setupDepths();
@@ -220,22 +256,24 @@ float StrokeEngine::getSensation() {
 }
 
 bool StrokeEngine::setPattern(int patternIndex, bool applyNow = false) {
+    RECORD(SESSION_SET_PATTERN, applyNow ? SESSION_FLAG_APPLY_NOW : 0, patternIndex);
+
     // Check wether pattern Index is in range
-    if ((patternIndex < patternTableSize) && (patternIndex >= 0) && (patternIndex != _patternIndex)) {
+    if ((patternIndex < int(PatternRegistry::size())) && (patternIndex >= 0) && (patternIndex != _patternIndex)) {
         _patternIndex = patternIndex;
 
         // Inject current motion parameters into new pattern
         if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-            patternTable[_patternIndex]->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration, _motor->stepsPerMillimeter);
-            patternTable[_patternIndex]->setTimeOfStroke(_timeOfStroke);
-            patternTable[_patternIndex]->setStroke(_stroke);
-            patternTable[_patternIndex]->setDepth(_depth);
-            patternTable[_patternIndex]->setSensation(_sensation);
+            _injectSettings(PatternRegistry::get(_patternIndex));
+
+            // Precomputed strokes belong to the previous pattern
+            _clearLookahead();
 
             // When running a pattern and immediate update requested: 
             if ((_state == PATTERN) && (applyNow == true)) {
                 // set flag to apply update from stroking thread
                 _applyUpdate = true;
+                _updates.replanRequests++;
 
 #ifdef DEBUG_TALKATIVE
             Serial.println("Apply New Settings Now");
@@ -247,10 +285,15 @@ bool StrokeEngine::setPattern(int patternIndex, bool applyNow = false) {
 
             // give back mutex
             xSemaphoreGive(_patternMutex);
+
+            // Wake the stroking task so the update is applied without delay
+            if (applyNow == true) {
+                _notifyMotionTask();
+            }
         }
 
 #ifdef DEBUG_TALKATIVE
-    Serial.println("setPattern: [" + String(_patternIndex) + "] " + patternTable[_patternIndex]->getName());
+    Serial.println("setPattern: [" + String(_patternIndex) + "] " + PatternRegistry::get(_patternIndex)->getName());
     Serial.println("setTimeOfStroke: " + String(_timeOfStroke, 2));
     Serial.println("setDepth: " + String(_depth));
     Serial.println("setStroke: " + String(_stroke));
@@ -272,7 +315,7 @@ int StrokeEngine::getPattern() {
 
 bool StrokeEngine::startPattern() {
     // Only valid if state is ready
-    if (_state == READY || _state == SETUPDEPTH || _state == STREAMING) {
+    if (_state == READY || _state == SETUPDEPTH || _state == STREAMING || _state == STOPPING) {
 
         // Stop current move, should one be pending (moveToMax or moveToMin)
         if (servo->isRunning()) {
@@ -284,18 +327,11 @@ bool StrokeEngine::startPattern() {
 
         // Set state to PATTERN
         _state = PATTERN;
+        _preparePattern();
 
-        // Reset Stroke and Motion parameters
-        _index = -1;
-        if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-            patternTable[_patternIndex]->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration, _motor->stepsPerMillimeter);
-            patternTable[_patternIndex]->setTimeOfStroke(_timeOfStroke);
-            patternTable[_patternIndex]->setStroke(_stroke);
-            patternTable[_patternIndex]->setDepth(_depth);
-            patternTable[_patternIndex]->setSensation(_sensation);            
-            xSemaphoreGive(_patternMutex);
-        }
-
+        RECORD(SESSION_LIMITS, 0, servo->getCurrentPosition(), _maxStepPerSecond, _maxStepAcceleration, _maxStepJerk);
+        RECORD(SESSION_START_PATTERN, 0, _patternIndex, _depth, _stroke, 
+            sessionFromFloat(_timeOfStroke), sessionFromFloat(_sensation));
         
 #ifdef DEBUG_TALKATIVE
         Serial.print(" _timeOfStroke: " + String(_timeOfStroke));
@@ -316,8 +352,10 @@ bool StrokeEngine::startPattern() {
                 1                       // Pin to application core
             ); 
         } else {
-            // Resume task, if it already exists
+            // Resume task, if it already exists. Wake it up as well in case it still
+            // sleeps for a move interrupted by a stop.
             vTaskResume(_taskStrokingHandle);
+            xTaskNotifyGive(_taskStrokingHandle);
         }
 
 #ifdef DEBUG_TALKATIVE
@@ -339,7 +377,7 @@ bool StrokeEngine::startPattern() {
 
 bool StrokeEngine::startStreaming() {
     // Only valid if state is ready
-    if (_state == READY || _state == SETUPDEPTH || _state == PATTERN) {
+    if (_state == READY || _state == SETUPDEPTH || _state == PATTERN || _state == STOPPING) {
 
         // Stop current move, should one be pending (moveToMax or moveToMin)
         if (servo->isRunning()) {
@@ -351,12 +389,11 @@ bool StrokeEngine::startStreaming() {
 
         // Set state to PATTERN
         _state = STREAMING;
+        _prepareStreaming();
 
-        livePosition->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration, _motor->stepsPerMillimeter);
-        livePosition->setTimeOfStroke(_timeOfStroke);
-        livePosition->setStroke(_stroke);
-        livePosition->setDepth(_depth);
-        livePosition->setSensation(_sensation);    
+        RECORD(SESSION_LIMITS, 0, servo->getCurrentPosition(), _maxStepPerSecond, _maxStepAcceleration, _maxStepJerk);
+        RECORD(SESSION_START_STREAMING, 0, _patternIndex, _depth, _stroke, 
+            sessionFromFloat(_timeOfStroke), sessionFromFloat(_sensation));
 
         if (_taskStreamingHandle == NULL) {
             // Create Stroke Task
@@ -370,8 +407,10 @@ bool StrokeEngine::startStreaming() {
                 1                       // Pin to application core
             ); 
         } else {
-            // Resume task, if it already exists
+            // Resume task, if it already exists. Wake it up as well in case it still
+            // sleeps for a move interrupted by a stop.
             vTaskResume(_taskStreamingHandle);
+            xTaskNotifyGive(_taskStreamingHandle);
         }
 
 #ifdef DEBUG_TALKATIVE
@@ -394,8 +433,11 @@ bool StrokeEngine::startStreaming() {
 void StrokeEngine::stopMotion() {
     // only valid when 
     if (_state == PATTERN || _state == SETUPDEPTH || _state == STREAMING) {
-        // Set state
-        _state = READY;
+        RECORD(SESSION_STOP, 0, servo->getCurrentPosition());
+
+        // Set state, the motion tasks suspend themselves
+        xEventGroupClearBits(_stopEvents, STOP_EVENT_IDLE);
+        _state = STOPPING;
 
         // Stop servo motor as fast as legally allowed
         servo->setAcceleration(_maxStepAcceleration);
@@ -403,16 +445,22 @@ void StrokeEngine::stopMotion() {
         servo->stopMove();
 
 #ifdef DEBUG_TALKATIVE
-        Serial.println("Motion stopped");
+        Serial.println("Motion stopping");
 #endif
 
-        // Wait for servo stopped
-        while (servo->isRunning());
-
-        // Send telemetry data
-        if (_callbackTelemetry != NULL) {
-            _callbackTelemetry(float(servo->getCurrentPosition() / _motor->stepsPerMillimeter), 0.0, false);
+        // Hand the deceleration over to the stopping task instead of waiting here
+        if (_taskStoppingHandle == NULL) {
+            xTaskCreatePinnedToCore(
+                this->_stoppingImpl,        // Function that should be called
+                "Stopping",                 // Name of the task (for debugging)
+                2048,                       // Stack size (bytes)
+                this,                       // Pass reference to this class instance
+                20,                         // Pretty high task priority
+                &_taskStoppingHandle,       // Task handle
+                1                           // Have it on application core
+            );
         }
+        xTaskNotifyGive(_taskStoppingHandle);
     }
     
 #ifdef DEBUG_TALKATIVE
@@ -420,6 +468,14 @@ void StrokeEngine::stopMotion() {
 #endif
 }
 
+bool StrokeEngine::waitForStop(TickType_t ticksToWait) {
+    return (xEventGroupWaitBits(_stopEvents, STOP_EVENT_IDLE, pdFALSE, pdTRUE, ticksToWait) & STOP_EVENT_IDLE) != 0;
+}
+
+void StrokeEngine::registerStopCallback(void(*callbackStopped)()) {
+    _callbackStopped = callbackStopped;
+}
+
 void StrokeEngine::enableAndHome(endstopProperties *endstop, void(*callBackHoming)(bool), float speed) {
     // Store callback
     _callBackHomeing = callBackHoming;
@@ -541,19 +597,11 @@ bool StrokeEngine::moveToMax(float speed) {
 #endif
 
     if (_isHomed) {
-        // Stop motion immediately
+        // Stop motion immediately, move once the axis came to a standstill
         stopMotion();
-
-        // Set feedrate for safe move 
-        // Constrain speed between 1 step/sec and _maxStepPerSecond
-        servo->setSpeedInHz(constrain(speed * _motor->stepsPerMillimeter, 1, _maxStepPerSecond));
-        servo->setAcceleration(_maxStepAcceleration / 10);
-        servo->moveTo(_maxStep);
-
-        // Send telemetry data
-        if (_callbackTelemetry != NULL) {
-            _callbackTelemetry(float(_maxStep / _motor->stepsPerMillimeter), speed, false);
-        } 
+        if (_deferMove(PENDING_MAX, speed) == false) {
+            _startMove(PENDING_MAX, speed);
+        }
 
 #ifdef DEBUG_TALKATIVE
         Serial.println("Stroke Engine State: " + verboseState[_state]);
@@ -575,19 +623,11 @@ bool StrokeEngine::moveToMin(float speed) {
 #endif
 
     if (_isHomed) {
-        // Stop motion immediately
+        // Stop motion immediately, move once the axis came to a standstill
         stopMotion();
-
-        // Set feedrate for safe move 
-        // Constrain speed between 1 step/sec and _maxStepPerSecond
-        servo->setSpeedInHz(constrain(speed * _motor->stepsPerMillimeter, 1, _maxStepPerSecond));
-        servo->setAcceleration(_maxStepAcceleration / 10);
-        servo->moveTo(_minStep);
-
-        // Send telemetry data
-        if (_callbackTelemetry != NULL) {
-            _callbackTelemetry(float(_minStep / _motor->stepsPerMillimeter), speed, false);
-        } 
+        if (_deferMove(PENDING_MIN, speed) == false) {
+            _startMove(PENDING_MIN, speed);
+        }
 
 #ifdef DEBUG_TALKATIVE
     Serial.println("Stroke Engine State: " + verboseState[_state]);
@@ -614,19 +654,11 @@ bool StrokeEngine::setupDepth(float speed, bool fancy) {
 
     // isHomed is only true in states READY, PATTERN and SETUPDEPTH
     if (_isHomed) {
-        // Stop motion immediately
+        // Stop motion immediately, follow the depth once the axis came to a standstill
         stopMotion();
-
-        // Set feedrate for safe move 
-        // Constrain speed between 1 step/sec and _maxStepPerSecond
-        servo->setSpeedInHz(constrain(speed * _motor->stepsPerMillimeter, 1, _maxStepPerSecond));
-        servo->setAcceleration(_maxStepAcceleration / 10);
-
-        // Set new state
-        _state = SETUPDEPTH;
-
-        // move to current depth position
-        _setupDepths();
+        if (_deferMove(PENDING_DEPTH, speed) == false) {
+            _startMove(PENDING_DEPTH, speed);
+        }
 
         // set return value to true
         allowed = true;
@@ -649,7 +681,11 @@ void StrokeEngine::disable() {
     }
     _abortHoming = false;
 
+    // A stop in progress completes without going to READY
+    portENTER_CRITICAL(&stopMux);
     _state = UNDEFINED;
+    _pendingMove = PENDING_NONE;
+    portEXIT_CRITICAL(&stopMux);
     _isHomed = false;
 
     // Disable servo motor
@@ -669,8 +705,8 @@ void StrokeEngine::disable() {
 }
 
 String StrokeEngine::getPatternName(int index) {
-    if (index >= 0 && index <= patternTableSize) {
-        return String(patternTable[index]->getName());
+    if (index >= 0 && index < int(PatternRegistry::size())) {
+        return String(PatternRegistry::get(index)->getName());
     } else {
         return String("Invalid");
     }
@@ -678,13 +714,10 @@ String StrokeEngine::getPatternName(int index) {
 }
 
 void StrokeEngine::setMaxSpeed(float maxSpeed){
-    // Update pattern with new speed limits
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-        // Convert speed into steps
-        _maxStepPerSecond = int(0.5 + _motor->maxSpeed * _motor->stepsPerMillimeter);
-        patternTable[_patternIndex]->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration, _motor->stepsPerMillimeter);
-        xSemaphoreGive(_patternMutex);
-    }
+    RECORD(SESSION_SET_MAX_SPEED, 0, 0, sessionFromFloat(maxSpeed));
+
+    // Convert speed into steps, the pattern gets the new speed limits with the next stroke
+    _publishSetting(_maxStepPerSecond, int(0.5 + _motor->maxSpeed * _motor->stepsPerMillimeter), false);
 }
 
 void StrokeEngine::setPhysicalTravel(float travel) {
@@ -701,26 +734,147 @@ float StrokeEngine::getMaxSpeed() {
 }
 
 void StrokeEngine::setMaxAcceleration(float maxAcceleration) {
+    RECORD(SESSION_SET_MAX_ACCELERATION, 0, 0, sessionFromFloat(maxAcceleration));
 
-    // Update pattern with new speed limits
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-        // Convert acceleration into steps
-        _maxStepAcceleration = int(0.5 + _motor->maxAcceleration * _motor->stepsPerMillimeter);
-        patternTable[_patternIndex]->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration, _motor->stepsPerMillimeter);
-        xSemaphoreGive(_patternMutex);
-    }    
+    // Convert acceleration into steps, the pattern gets the new speed limits with the next stroke
+    _publishSetting(_maxStepAcceleration, int(0.5 + _motor->maxAcceleration * _motor->stepsPerMillimeter), false);
 }
 
 float StrokeEngine::getMaxAcceleration() {
     return float(_maxStepAcceleration / _motor->stepsPerMillimeter);
 }
 
+void StrokeEngine::setMaxJerk(float maxJerk) {
+    RECORD(SESSION_SET_MAX_JERK, 0, 0, sessionFromFloat(maxJerk));
+
+    // Used with the next move, precomputed moves are not affected
+    // Convert jerk into steps, negative values disable the limit
+    _maxStepJerk = int(0.5 + max(maxJerk, 0.0f) * _motor->stepsPerMillimeter);
+
+#ifdef DEBUG_TALKATIVE
+    Serial.println("setMaxJerk: " + String(_maxStepJerk));
+#endif
+}
+
+float StrokeEngine::getMaxJerk() {
+    return float(_maxStepJerk / _motor->stepsPerMillimeter);
+}
+
 float StrokeEngine::getMaxDepth() {
     return _travel;
 }
 
 void StrokeEngine::registerTelemetryCallback(void(*callbackTelemetry)(float, float, bool)) {
     _callbackTelemetry = callbackTelemetry;
+
+    // The callback is called from a task of its own, so it can't delay the motion
+    if ((callbackTelemetry != NULL) && (_taskTelemetryHandle == NULL)) {
+        xTaskCreatePinnedToCore(
+            this->_telemetryImpl,       // Function that should be called
+            "Telemetry",                // Name of the task (for debugging)
+            4096,                       // Stack size (bytes)
+            this,                       // Pass reference to this class instance
+            1,                          // Low priority, telemetry is best effort
+            &_taskTelemetryHandle,      // Task handle
+            0                           // Pin to communication core
+        );
+    }
+}
+
+bool StrokeEngine::readTelemetry(telemetryRecord &record) {
+    return _telemetry.pop(record);
+}
+
+unsigned long StrokeEngine::getTelemetryDropCount() {
+    return _telemetryDropped;
+}
+
+void StrokeEngine::setRamp(rampMode mode, float length) {
+    // Used from the next parameter change on, RAMP_NONE also ends a running ramp
+    _rampLength = max(length, 0.0f);
+    _rampMode = mode;
+
+#ifdef DEBUG_TALKATIVE
+    Serial.println("setRamp: " + String(int(_rampMode)) + " " + String(_rampLength, 2));
+#endif
+}
+
+bool StrokeEngine::isRamping() {
+    return _rampActive;
+}
+
+updateCounters StrokeEngine::getUpdateCounters() {
+    return _updates;
+}
+
+void StrokeEngine::resetUpdateCounters() {
+    _updates = updateCounters();
+}
+
+motionStats StrokeEngine::getStats() {
+#ifdef STROKEENGINE_STATS
+    return _stats;
+#else
+    return motionStats();
+#endif
+}
+
+void StrokeEngine::resetStats() {
+#ifdef STROKEENGINE_STATS
+    _stats = motionStats();
+#endif
+}
+
+size_t StrokeEngine::getSessionSize() {
+#ifdef STROKEENGINE_RECORDER
+    return sizeof(sessionFileHeader) + _recorder.size() * sizeof(sessionEvent);
+#else
+    return 0;
+#endif
+}
+
+size_t StrokeEngine::exportSession(void *buffer, size_t size) {
+#ifdef STROKEENGINE_RECORDER
+    // Keep the ring still while it is copied, events in between are lost
+    portENTER_CRITICAL(&recorderMux);
+    _recording = false;
+    portEXIT_CRITICAL(&recorderMux);
+
+    size_t written = 0;
+    size_t count = _recorder.size();
+    if ((buffer != NULL) && (size >= sizeof(sessionFileHeader) + count * sizeof(sessionEvent))) {
+        sessionFileHeader header;
+        memcpy(header.magic, SESSION_FILE_MAGIC, 4);
+        header.version = SESSION_FILE_VERSION;
+        header.reserved = 0;
+        header.count = count;
+        header.stepsPerMillimeter = _motor->stepsPerMillimeter;
+        header.physicalTravel = _physics->physicalTravel;
+        header.keepoutBoundary = _physics->keepoutBoundary;
+        header.maxSpeed = _motor->maxSpeed;
+        header.maxAcceleration = _motor->maxAcceleration;
+
+        uint8_t *output = (uint8_t *)buffer;
+        memcpy(output, &header, sizeof(header));
+        for (size_t i = 0; i < count; i++) {
+            memcpy(output + sizeof(header) + i * sizeof(sessionEvent), &_recorder.get(i), sizeof(sessionEvent));
+        }
+        written = sizeof(header) + count * sizeof(sessionEvent);
+    }
+
+    _recording = true;
+    return written;
+#else
+    return 0;
+#endif
+}
+
+void StrokeEngine::clearSession() {
+#ifdef STROKEENGINE_RECORDER
+    portENTER_CRITICAL(&recorderMux);
+    _recorder.clear();
+    portEXIT_CRITICAL(&recorderMux);
+#endif
 }
 
 float StrokeEngine::_getAnalogAveragePercent(int pinNumber, int samples) {
@@ -739,6 +893,14 @@ float StrokeEngine::_getAnalogAveragePercent(int pinNumber, int samples) {
 }
 
 void StrokeEngine::_homingProcedure() {
+    // Motion stopped by enableAndHome() may still be decelerating
+    while (waitForStop(20 / portTICK_PERIOD_MS) == false) {
+        if (_abortHoming) {
+            _taskHomingHandle = NULL;
+            vTaskDelete(NULL);
+        }
+    }
+
     if(_sensorlessHomeing) {
         _sensorlessHomingProcedure();
     } else {
@@ -848,9 +1010,7 @@ void StrokeEngine::_sensorlessHomingProcedure() {
     }
 
     // Set first point for telemetry
-    if (_callbackTelemetry != NULL) {
-        _callbackTelemetry(0.0, 0.0, false);
-    }
+    _pushTelemetry(0.0, 0.0);
 
 #ifdef DEBUG_TALKATIVE
     Serial.println("Stroke Engine State: " + verboseState[_state]);
@@ -939,9 +1099,7 @@ void StrokeEngine::_sensorHomingProcedure() {
     }
 
     // Set first point for telemetry
-    if (_callbackTelemetry != NULL) {
-        _callbackTelemetry(0.0, 0.0, false);
-    }
+    _pushTelemetry(0.0, 0.0);
 
 #ifdef DEBUG_TALKATIVE
     Serial.println("Stroke Engine State: " + verboseState[_state]);
@@ -953,143 +1111,247 @@ void StrokeEngine::_sensorHomingProcedure() {
 }
 
 void StrokeEngine::_stroking() {
-    motionParameter currentMotion;
-
     while(1) { // infinite loop
 
         // Suspend task, if not in PATTERN state
         if (_state != PATTERN) {
+#ifdef STROKEENGINE_STATS
+            // Time spent suspended is neither a loop period nor a gap between moves
+            _statsLastLoop = 0;
+            _statsMoving = false;
+#endif
             vTaskSuspend(_taskStrokingHandle);
         }
 
-        // Take mutex to ensure no interference / race condition with communication threat on other core
-        if (xSemaphoreTake(_patternMutex, 0) == pdTRUE) {
+        // Sleep until the current move is predicted to complete, a deferred re-plan 
+        // is due or a notification signals an update that must be applied now
+        ulTaskNotifyTake(pdTRUE, _strokingCycle());
+    }
+}
 
-            if (_applyUpdate == true) {
-                // Ask pattern for update on motion parameters
-                currentMotion = patternTable[_patternIndex]->nextTarget(_index);
-            
-                // Increase deceleration if required to avoid crash
-                if (servo->getAcceleration() > currentMotion.acceleration) {
+TickType_t StrokeEngine::_strokingCycle() {
+    motionParameter currentMotion;
+
+#ifdef STROKEENGINE_STATS
+    uint32_t loopStart = micros();
+    if (_statsLastLoop != 0) {
+        _stats.loopPeriod.add(loopStart - _statsLastLoop);
+    }
+    _statsLastLoop = loopStart;
+#endif
+
+    // Take mutex to ensure no interference / race condition with communication threat on other core
+    if (xSemaphoreTake(_patternMutex, 0) == pdTRUE) {
+
+        // Take over parameters published by the set-functions since the last iteration
+        _applySettings();
+
+        // Re-plan the running stroke, but not more often than every REPLAN_INTERVAL_MS
+        if ((_applyUpdate == true) && (_replanAllowed() == true)) {
+            // Precomputed strokes are outdated by the update
+            _clearLookahead();
+
+            // Ask pattern for update on motion parameters
+            currentMotion = _computeMotion(_index);
+        
+            // Increase deceleration if required to avoid crash
+            if (servo->getAcceleration() > currentMotion.acceleration) {
 #ifdef DEBUG_CLIPPING
-                    Serial.print("Crash avoidance! Set Acceleration from " + String(currentMotion.acceleration));
-                    Serial.println(" to " + String(servo->getAcceleration()));
+                Serial.print("Crash avoidance! Set Acceleration from " + String(currentMotion.acceleration));
+                Serial.println(" to " + String(servo->getAcceleration()));
 #endif
-                    currentMotion.acceleration = servo->getAcceleration();
-                }
+                currentMotion.acceleration = servo->getAcceleration();
+                STATS_COUNT(crashAvoidance);
+            }
 
-                // Apply new trapezoidal motion profile to servo
-                _applyMotionProfile(&currentMotion);
+            // Apply new trapezoidal motion profile to servo
+            _applyMotionProfile(&currentMotion);
+
+            // clear update flag
+            _applyUpdate = false;
+            _lastReplan = micros();
+            _replanned = true;
+            _updates.replans++;
+        }
+
+        // If motor has stopped, or the next target can be blended into the current 
+        // move, issue moveTo command to next position
+        else if ((servo->isRunning() == false) || 
+                (_canBlend(PatternRegistry::get(_patternIndex)) && (long(micros() - _blendDeadline) >= 0))) {
 
-                // clear update flag
+            // A deferred re-plan is obsolete once the next stroke is computed 
+            // from the current parameters
+            if ((_applyUpdate == true) && (_settings.sequence() == _settingsApplied)) {
                 _applyUpdate = false;
             }
 
-            // If motor has stopped issue moveTo command to next position
-            else if (servo->isRunning() == false) {
+            // Increment index for pattern
+            _index++;
 
-                // Increment index for pattern
-                _index++;
-
-                // Querey new set of pattern parameters
-                currentMotion = patternTable[_patternIndex]->nextTarget(_index);
+            // Use the precomputed stroke if available, query the pattern otherwise
+            if (_lookaheadCount > 0) {
+                currentMotion = _lookahead[_lookaheadHead];
+                _lookaheadHead = (_lookaheadHead + 1) % MOTION_LOOKAHEAD;
+                _lookaheadCount--;
+            } else {
+                currentMotion = _computeMotion(_index);
+            }
 
-                // Pattern may introduce pauses between strokes
-                if (currentMotion.skip == false) {
+            // Pattern may introduce pauses between strokes
+            if (currentMotion.skip == false) {
 
 #ifdef DEBUG_STROKE
-                    Serial.println("Stroking Index: " + String(_index));
+                Serial.println("Stroking Index: " + String(_index));
 #endif
-                    // Apply new trapezoidal motion profile to servo
-                    _applyMotionProfile(&currentMotion);
+                // Apply new trapezoidal motion profile to servo
+                _applyMotionProfile(&currentMotion);
+
+            } else {
+                // decrement _index so that it stays the same until the next valid stroke parameters are delivered
+                _index--;
 
-                } else {
-                    // decrement _index so that it stays the same until the next valid stroke parameters are delivered
-                    _index--;
-                }
+                // query the pattern again after a short pause
+                _moveDeadline = micros() + (PAUSE_POLL_MS * 1000);
             }
+        }
 
-            // give back mutex
-            xSemaphoreGive(_patternMutex);
+        // While the servo is busy precompute the next strokes, so pattern math 
+        // is off the critical path between two strokes
+        if (servo->isRunning() == true) {
+            _fillLookahead(PatternRegistry::get(_patternIndex));
+
+            // Wake up when the current move starts decelerating to blend into the next one
+            if (_canBlend(PatternRegistry::get(_patternIndex))) {
+                _moveDeadline = _blendDeadline;
+            }
         }
-        
-        // Delay 10ms 
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+
+        // give back mutex
+        xSemaphoreGive(_patternMutex);
+    }
+#ifdef STROKEENGINE_STATS
+    else {
+        _stats.mutexMisses++;
     }
+#endif
+
+    // Time until the current move completes or a deferred re-plan is due
+    TickType_t ticks = _ticksUntilMoveCompletes();
+    if (_applyUpdate == true) {
+        ticks = min(ticks, _ticksUntilReplanAllowed());
+    }
+    return ticks;
 }
 
 void StrokeEngine::_streaming() {
-    motionParameter currentMotion;
-
     while(1) { // infinite loop
 
         // Suspend task, if not in STREAMING state
         if (_state != STREAMING) {
+#ifdef STROKEENGINE_STATS
+            // Time spent suspended is neither a loop period nor a gap between moves
+            _statsLastLoop = 0;
+            _statsMoving = false;
+#endif
             vTaskSuspend(_taskStreamingHandle);
         }
 
-        // Take mutex to ensure no interference / race condition with communication threat on other core
-        if (xSemaphoreTake(_patternMutex, 0) == pdTRUE) {
+        // Sleep until the current move is predicted to complete or a 
+        // notification signals an update that must be applied now
+        ulTaskNotifyTake(pdTRUE, _streamingCycle());
+    }
+}
 
-            if (_applyUpdate == true) {
-                // Ask pattern for update on motion parameters
-                currentMotion = livePosition->nextTarget(_index);
-            
-                // Increase deceleration if required to avoid crash
-                if (servo->getAcceleration() > currentMotion.acceleration) {
-#ifdef DEBUG_CLIPPING
-                    Serial.print("Crash avoidance! Set Acceleration from " + String(currentMotion.acceleration));
-                    Serial.println(" to " + String(servo->getAcceleration()));
+TickType_t StrokeEngine::_streamingCycle() {
+    motionParameter currentMotion;
+
+#ifdef STROKEENGINE_STATS
+    uint32_t loopStart = micros();
+    if (_statsLastLoop != 0) {
+        _stats.loopPeriod.add(loopStart - _statsLastLoop);
+    }
+    _statsLastLoop = loopStart;
 #endif
-                    currentMotion.acceleration = servo->getAcceleration();
-                }
 
-                // Apply new trapezoidal motion profile to servo
-                _applyMotionProfile(&currentMotion);
+    // Take mutex to ensure no interference / race condition with communication threat on other core
+    if (xSemaphoreTake(_patternMutex, 0) == pdTRUE) {
 
-                // clear update flag
-                _applyUpdate = false;
+        // Take over parameters published by the set-functions since the last iteration
+        _applySettings();
+
+        if (_applyUpdate == true) {
+            // Ask pattern for update on motion parameters, planned from the real axis state
+            _updateActualState();
+            currentMotion = _computeMotion(_index);
+        
+            // Increase deceleration if required to avoid crash
+            if (servo->getAcceleration() > currentMotion.acceleration) {
+#ifdef DEBUG_CLIPPING
+                Serial.print("Crash avoidance! Set Acceleration from " + String(currentMotion.acceleration));
+                Serial.println(" to " + String(servo->getAcceleration()));
+#endif
+                currentMotion.acceleration = servo->getAcceleration();
+                STATS_COUNT(crashAvoidance);
             }
 
-            // If motor has stopped issue moveTo command to next position
-            else if (servo->isRunning() == false) {
+            // Apply new trapezoidal motion profile to servo
+            _applyMotionProfile(&currentMotion);
+
+            // clear update flag
+            _applyUpdate = false;
+        }
+
+        // If motor has stopped issue moveTo command to next position
+        else if (servo->isRunning() == false) {
 
-                // Increment index for pattern
-                _index++;
+            // Increment index for pattern
+            _index++;
 
-                // Querey new set of pattern parameters
-                currentMotion = livePosition->nextTarget(_index);
+            // Querey new set of pattern parameters, planned from the real axis state
+            _updateActualState();
+            currentMotion = _computeMotion(_index);
 
-                // Pattern may introduce pauses between strokes
-                if (currentMotion.skip == false) {
+            // Pattern may introduce pauses between strokes
+            if (currentMotion.skip == false) {
 
 #ifdef DEBUG_STROKE
-                    Serial.println("Stroking Index: " + String(_index));
+                Serial.println("Stroking Index: " + String(_index));
 #endif
-                    // Apply new trapezoidal motion profile to servo
-                    _applyMotionProfile(&currentMotion);
+                // Apply new trapezoidal motion profile to servo
+                _applyMotionProfile(&currentMotion);
 
-                } else {
-                    // decrement _index so that it stays the same until the next valid stroke parameters are delivered
-                    _index--;
-                }
-            }
+            } else {
+                // decrement _index so that it stays the same until the next valid stroke parameters are delivered
+                _index--;
 
-            // give back mutex
-            xSemaphoreGive(_patternMutex);
+                // query the pattern again after a short pause
+                _moveDeadline = micros() + (PAUSE_POLL_MS * 1000);
+            }
         }
-        
-        // Delay 10ms 
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+
+        // give back mutex
+        xSemaphoreGive(_patternMutex);
     }
+#ifdef STROKEENGINE_STATS
+    else {
+        _stats.mutexMisses++;
+    }
+#endif
+
+    return _ticksUntilMoveCompletes();
 }
 
-void StrokeEngine::_applyMotionProfile(motionParameter* motion) {
+uint8_t StrokeEngine::_applyMotionProfile(motionParameter* motion) {
 
-    bool clipping = false;
+    uint8_t clipping = 0;
     float speed = 0.0;
     float position = 0.0;
 
+#ifdef STROKEENGINE_RECORDER
+    // The move as requested, clipping is recomputed on replay
+    motionParameter requested = *motion;
+#endif
+
     // Apply new trapezoidal motion profile to servo if pattern does not skip
     if (motion->skip == false) {
 
@@ -1100,7 +1362,8 @@ void StrokeEngine::_applyMotionProfile(motionParameter* motion) {
                 + "mm/s --> Limit: " + String(float(_maxStepPerSecond / _motor->stepsPerMillimeter), 2) + "mm/s");
 #endif
             motion->speed = _maxStepPerSecond;
-            clipping = true;
+            clipping |= TELEMETRY_CLIP_SPEED;
+            STATS_COUNT(clippedSpeed);
         } 
 
         // Constrain acceleration between 1 step/sec^2 and _maxStepAcceleration
@@ -1110,17 +1373,69 @@ void StrokeEngine::_applyMotionProfile(motionParameter* motion) {
                 + "mm/s² --> Limit: " + String(float(_maxStepAcceleration / _motor->stepsPerMillimeter), 2) + "mm/s²");
 #endif
             motion->acceleration = _maxStepAcceleration;
-            clipping = true;
+            clipping |= TELEMETRY_CLIP_ACCELERATION;
+            STATS_COUNT(clippedAcceleration);
         } 
 
+        // Moves without own jerk limit use the global one. Constrain jerk to below _maxStepJerk.
+        if ((_maxStepJerk > 0) && ((motion->jerk <= 0) || (motion->jerk > _maxStepJerk))) {
+            motion->jerk = _maxStepJerk;
+        }
+
+        // FastAccelStepper limits jerk by ramping acceleration linearly from standstill 
+        // over a number of steps. Reaching acceleration a with jerk j takes a³ / 6j² steps.
+        // Round up, a shorter ramp exceeds the jerk limit and a ramp of 0 steps disables it.
+        uint32_t linearAccelerationSteps = 0;
+        if (motion->jerk > 0) {
+            float a = float(motion->acceleration);
+            float j = float(motion->jerk);
+            linearAccelerationSteps = max(uint32_t(ceilf(a * a * a / (6.0f * j * j))), uint32_t(1));
+        }
+
         // Constrain stroke to motion envelope
         int pos = constrain((motion->stroke), _minStep, _maxStep);
+        if (pos != motion->stroke) {
+            clipping |= TELEMETRY_CLIP_POSITION;
+            STATS_COUNT(clippedPosition);
+        }
 
         // write values to servo
         servo->setSpeedInHz(motion->speed);
         servo->setAcceleration(motion->acceleration);
+        servo->setLinearAcceleration(linearAccelerationSteps);
         servo->moveTo(pos);
 
+        // Predict when the move completes, so the motion task wakes up just in time
+        unsigned long now = micros();
+        int distance = pos - servo->getCurrentPosition();
+        float startSpeed = float(servo->getCurrentSpeedInMilliHz()) / 1000.0f;
+        unsigned long duration = _predictMoveDuration(distance, motion->speed, motion->acceleration, startSpeed);
+
+        // The acceleration ramps of an S-curve add about a/j to the move
+        if ((duration > 0) && (motion->jerk > 0)) {
+            duration += (unsigned long)(1.0e6f * float(motion->acceleration) / float(motion->jerk));
+        }
+#ifdef STROKEENGINE_STATS
+        // Blended moves and updates are issued before the previous move completes
+        if (_statsMoving) {
+            long gap = long(now - _moveDeadline);
+            _stats.moveGap.add((gap > 0) ? uint32_t(gap) : 0);
+        }
+        _statsMoving = true;
+        _stats.moves++;
+#endif
+        _moveDeadline = now + duration;
+
+        // Deceleration takes v/a on a trapezoid and half the move on a triangle
+        unsigned long decelerationTime = 0;
+        if (duration > 0) {
+            decelerationTime = (unsigned long)(1.0e6f * float(motion->speed) / float(motion->acceleration));
+            decelerationTime = min(decelerationTime, duration / 2);
+        }
+        _blendDeadline = _moveDeadline - decelerationTime;
+        _moveTarget = pos;
+        _moveDirection = (distance > 0) - (distance < 0);
+
         // Compile speed telemetry data
         speed = float(motion->speed / _motor->stepsPerMillimeter);
         position = float(pos / _motor->stepsPerMillimeter);
@@ -1131,10 +1446,496 @@ void StrokeEngine::_applyMotionProfile(motionParameter* motion) {
     Serial.println("motion.acceleration: " + String(float(motion->acceleration / _motor->stepsPerMillimeter), 2) + "mm/s²");
 #endif
 
+        // Queue telemetry data, the consumer picks it up at its own pace
+        _pushTelemetry(position, speed, float(motion->acceleration / _motor->stepsPerMillimeter), clipping, 
+            _index, (_state == PATTERN) ? uint8_t(_patternIndex) : TELEMETRY_NO_PATTERN);
+
+        RECORD(SESSION_MOVE, clipping, _index, 
+            requested.stroke, requested.speed, requested.acceleration, requested.jerk);
+    }
+
+    return clipping;
+}
+
+motionParameter StrokeEngine::_computeMotion(int index) {
+    STATS_START(computeStart);
+    motionParameter motion;
+    if (_state == STREAMING) {
+        motion = livePosition->nextTarget(index);
+    } else {
+        motion = dispatchNextTarget(PatternRegistry::get(_patternIndex), index);
+    }
+    STATS_SAMPLE(nextTarget, computeStart);
+
+    RECORD(SESSION_COMPUTE, motion.skip ? SESSION_FLAG_SKIP : 0, index, 
+        motion.stroke, motion.speed, motion.acceleration, motion.jerk);
+    return motion;
+}
+
+void StrokeEngine::_updateActualState() {
+    int position = servo->getCurrentPosition();
+    int speed = servo->getCurrentSpeedInMilliHz() / 1000;
+    unsigned long now = millis();
+
+    RECORD(SESSION_AXIS, 0, 0, position, speed, int32_t(now));
+    livePosition->setActualState(position, speed, now);
+}
+
+unsigned long StrokeEngine::_predictMoveDuration(int distance, int speed, int acceleration, float startSpeed) {
+    // Guard against invalid profiles, the motion task falls back to polling then
+    if (speed <= 0 || acceleration <= 0) {
+        return 0;
+    }
+
+    // Work in the direction of the move, a negative start speed moves away from the target
+    float d = float(abs(distance));
+    float v = float(speed);
+    float a = float(acceleration);
+    float v0 = (distance < 0) ? -startSpeed : startSpeed;
+    float time = 0.0f;
+
+    // Moving away from the target, or too fast to stop at it: brake to standstill 
+    // first and move the remaining distance from there. Positions are only known 
+    // to a step, so an overshoot by less than that is not predicted.
+    float brakingDistance = v0 * v0 / (2.0f * a);
+    if ((v0 < 0.0f) || (brakingDistance > d + 1.0f)) {
+        time = fabsf(v0) / a;
+        d = fabsf(d - copysignf(brakingDistance, v0));
+        v0 = 0.0f;
+    }
+
+    // Faster than the new top speed: decelerate to it first
+    if (v0 > v) {
+        time += (v0 - v) / a;
+        d -= (v0 * v0 - v * v) / (2.0f * a);
+        v0 = v;
+    }
+
+    // Triangle: accelerate from v0 to the peak speed and decelerate to standstill
+    float peak = sqrtf(a * d + 0.5f * v0 * v0);
+    if (peak <= v) {
+        return (unsigned long)(1.0e6f * (time + (2.0f * peak - v0) / a));
+    }
+
+    // Trapezoid: distance is long enough to reach top speed
+    float cruise = d - (2.0f * v * v - v0 * v0) / (2.0f * a);
+    return (unsigned long)(1.0e6f * (time + (2.0f * v - v0) / a + cruise / v));
+}
+
+TickType_t StrokeEngine::_ticksUntilMoveCompletes() {
+    return _ticksUntil(_moveDeadline);
+}
+
+TickType_t StrokeEngine::_ticksUntil(unsigned long deadline) {
+    long remaining = long(deadline - micros());
+
+    // Deadline has passed, but the servo may not be finished yet. Check again next tick.
+    if (remaining <= 0) {
+        return 1;
+    }
+
+    // Round up to full ticks, waking early would only cause another wait cycle
+    const long tickInMicros = portTICK_PERIOD_MS * 1000;
+    return TickType_t((remaining + tickInMicros - 1) / tickInMicros);
+}
+
+bool StrokeEngine::_replanAllowed() {
+    // Measure the time since the last re-plan instead of comparing against a deadline,
+    // so a long period without re-plans can never block the next one. Forget the 
+    // last re-plan once the interval has passed, before micros() can wrap around it.
+    if ((_replanned == true) && (micros() - _lastReplan >= REPLAN_INTERVAL_MS * 1000UL)) {
+        _replanned = false;
+    }
+    return !_replanned;
+}
+
+TickType_t StrokeEngine::_ticksUntilReplanAllowed() {
+    // A re-plan that is allowed already but could not run, e.g. because the mutex
+    // was taken, is tried again with the next tick
+    if (_replanAllowed() == true) {
+        return 1;
+    }
+    return _ticksUntil(_lastReplan + REPLAN_INTERVAL_MS * 1000UL);
+}
+
+void StrokeEngine::_fillLookahead(Pattern *pattern) {
+    // Time dependent patterns must be queried at the moment the stroke is executed, 
+    // and ramped parameters change with every stroke
+    if ((pattern->allowsLookahead() == false) || (_rampActive == true)) {
+        return;
+    }
+
+    while (_lookaheadCount < MOTION_LOOKAHEAD) {
+        motionParameter motion = _computeMotion(_index + _lookaheadCount + 1);
+
+        // A pause is never cached, it is re-queried once it is due
+        if (motion.skip == true) {
+            return;
+        }
+
+        _lookahead[(_lookaheadHead + _lookaheadCount) % MOTION_LOOKAHEAD] = motion;
+        _lookaheadCount++;
+    }
+}
+
+void StrokeEngine::_clearLookahead() {
+    _lookaheadHead = 0;
+    _lookaheadCount = 0;
+}
+
+bool StrokeEngine::_canBlend(Pattern *pattern) {
+    // Blending requires a blending pattern and knowledge of the next target
+    if (pattern->getTrajectoryMode() != TRAJECTORY_BLEND || _lookaheadCount == 0) {
+        return false;
+    }
+
+    // Only targets continuing in the same direction can be passed with a non-zero 
+    // junction speed. A reversal needs the axis to come to a stop anyway.
+    int next = constrain(_lookahead[_lookaheadHead].stroke, _minStep, _maxStep) - _moveTarget;
+    int nextDirection = (next > 0) - (next < 0);
+    return (_moveDirection != 0) && (nextDirection == _moveDirection);
+}
+
+void StrokeEngine::_notifyMotionTask() {
+    if (_state == PATTERN && _taskStrokingHandle != NULL) {
+        xTaskNotifyGive(_taskStrokingHandle);
+    } else if (_state == STREAMING && _taskStreamingHandle != NULL) {
+        xTaskNotifyGive(_taskStreamingHandle);
+    }
+}
+
+void StrokeEngine::_preparePattern() {
+    // Reset Stroke and Motion parameters
+    _index = -1;
+    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+        _injectSettings(PatternRegistry::get(_patternIndex));
+        _clearLookahead();
+        xSemaphoreGive(_patternMutex);
+    }
+}
+
+void StrokeEngine::_prepareStreaming() {
+    _injectSettings(livePosition);
+}
+
+void StrokeEngine::_publishSettings(bool applyNow) {
+    // Serializes concurrent setters, the motion task never takes it
+    portENTER_CRITICAL(&settingsMux);
+    bool update = _publishSettingsLocked(applyNow);
+    portEXIT_CRITICAL(&settingsMux);
+
+    if (update) {
+#ifdef DEBUG_TALKATIVE
+        Serial.println("Apply New Settings Now");
+#endif
+        // Wake the stroking task so the update is applied without delay
+        _notifyMotionTask();
+    }
+}
+
+template <typename T>
+void StrokeEngine::_publishSetting(T &setting, T value, bool applyNow) {
+    // Writing the value inside the critical section keeps concurrent setters 
+    // from publishing a snapshot that misses or reverts the other's value
+    portENTER_CRITICAL(&settingsMux);
+    setting = value;
+    bool update = _publishSettingsLocked(applyNow);
+    portEXIT_CRITICAL(&settingsMux);
+
+    if (update) {
+#ifdef DEBUG_TALKATIVE
+        Serial.println("Apply New Settings Now");
+#endif
+        // Wake the stroking task so the update is applied without delay
+        _notifyMotionTask();
+    }
+}
+
+bool StrokeEngine::_publishSettingsLocked(bool applyNow) {
+    motionSettings settings;
+    settings.timeOfStroke = _timeOfStroke;
+    settings.depth = _depth;
+    settings.stroke = _stroke;
+    settings.sensation = _sensation;
+    settings.maxStepPerSecond = _maxStepPerSecond;
+    settings.maxStepAcceleration = _maxStepAcceleration;
+    _updates.received++;
+
+    // Repeating the current values publishes nothing
+    bool changed = memcmp(&settings, &_publishedSettings, sizeof(motionSettings)) != 0;
+    if (changed) {
+        _publishedSettings = settings;
+        _settings.write(settings);
+    }
+
+    // When running a pattern and immediate update requested: set flag to apply 
+    // update from stroking thread, unless the pattern has all values already
+    bool update = (_state == PATTERN) && (applyNow == true) && 
+        (changed || (_settings.sequence() != _settingsApplied));
+    if (update) {
+        _applyUpdate = true;
+        _updates.replanRequests++;
+    }
+    return update;
+}
+
+void StrokeEngine::_injectSettings(Pattern *pattern) {
+    // A new pattern or a start jumps to the target values
+    _settingsApplied = _settings.read(_appliedSettings);
+    _targetSettings = _appliedSettings;
+    _rampActive = false;
+    pattern->setSpeedLimit(_appliedSettings.maxStepPerSecond, _appliedSettings.maxStepAcceleration, 
+        _motor->stepsPerMillimeter);
+    pattern->setTimeOfStroke(_appliedSettings.timeOfStroke);
+    pattern->setStroke(_appliedSettings.stroke);
+    pattern->setDepth(_appliedSettings.depth);
+    pattern->setSensation(_appliedSettings.sensation);
+}
+
+bool StrokeEngine::_applySettings() {
+    bool published = (_settings.sequence() != _settingsApplied);
+
+    // Nothing was set since the last stroke boundary and no ramp is running
+    if ((published == false) && (_rampActive == false)) {
+        return false;
+    }
+
+    if (published == true) {
+        _settingsApplied = _settings.read(_targetSettings);
+        _updates.applied++;
+
+        // Ramp from the values the pattern has right now, which may be in the middle 
+        // of a previous ramp
+        if ((_rampMode != RAMP_NONE) && (_rampLength > 0.0)) {
+            _rampFrom = _appliedSettings;
+            _rampStart = micros();
+            _rampStartIndex = _index;
+            _rampActive = true;
+        }
+    }
+
+    // Progress is only sampled when the motion task wakes up, so a ramp advances in 
+    // steps of one move. Clamped, so the last step lands exactly on the target.
+    motionSettings settings = _targetSettings;
+    if (_rampActive == true) {
+        float progress = 1.0;
+        if (_rampMode == RAMP_TIME) {
+            progress = float(micros() - _rampStart) / (_rampLength * 1.0e6);
+        } else if (_rampMode == RAMP_STROKES) {
+            // Every stroke consists of two moves
+            progress = float(_index - _rampStartIndex) / (2.0 * _rampLength);
+        }
+        progress = constrain(progress, 0.0f, 1.0f);
+
+        if (progress < 1.0) {
+            settings.depth = _rampFrom.depth + int(lroundf(progress * (_targetSettings.depth - _rampFrom.depth)));
+            settings.stroke = _rampFrom.stroke + int(lroundf(progress * (_targetSettings.stroke - _rampFrom.stroke)));
+            settings.sensation = _rampFrom.sensation + progress * (_targetSettings.sensation - _rampFrom.sensation);
+
+            // Speed changes evenly in strokes per minute, not in time per stroke
+            float rate = 1.0 / _rampFrom.timeOfStroke;
+            rate += progress * (1.0 / _targetSettings.timeOfStroke - rate);
+            settings.timeOfStroke = 1.0 / rate;
+        } else {
+            _rampActive = false;
+        }
+    }
+
+    // Only changed parameters, each set-function of a pattern may recompute its timing
+    Pattern *pattern = (_state == STREAMING) ? livePosition : PatternRegistry::get(_patternIndex);
+    bool changed = false;
+    if ((settings.maxStepPerSecond != _appliedSettings.maxStepPerSecond) || 
+            (settings.maxStepAcceleration != _appliedSettings.maxStepAcceleration)) {
+        pattern->setSpeedLimit(settings.maxStepPerSecond, settings.maxStepAcceleration, _motor->stepsPerMillimeter);
+        changed = true;
+    }
+    if (settings.timeOfStroke != _appliedSettings.timeOfStroke) {
+        pattern->setTimeOfStroke(settings.timeOfStroke);
+        changed = true;
+    }
+    if (settings.stroke != _appliedSettings.stroke) {
+        pattern->setStroke(settings.stroke);
+        changed = true;
+    }
+    if (settings.depth != _appliedSettings.depth) {
+        pattern->setDepth(settings.depth);
+        changed = true;
+    }
+    if (settings.sensation != _appliedSettings.sensation) {
+        pattern->setSensation(settings.sensation);
+        changed = true;
+    }
+    _appliedSettings = settings;
+
+    // Precomputed strokes are based on the old settings
+    if (changed == true) {
+        _clearLookahead();
+    }
+    return changed;
+}
+
+void StrokeEngine::_pushTelemetry(float position, float speed, float acceleration, uint8_t clipping, 
+        int index, uint8_t pattern) {
+    telemetryRecord record;
+    record.timestamp = micros();
+    record.index = index;
+    record.position = position;
+    record.speed = speed;
+    record.acceleration = acceleration;
+    record.clipping = clipping;
+    record.pattern = pattern;
+
+    // Motion, homing and the main program all report moves. A full buffer drops 
+    // the record instead of waiting for the consumer.
+    portENTER_CRITICAL(&telemetryMux);
+    if (_telemetry.push(record) == false) {
+        _telemetryDropped++;
+    }
+    portEXIT_CRITICAL(&telemetryMux);
+
+    if (_taskTelemetryHandle != NULL) {
+        xTaskNotifyGive(_taskTelemetryHandle);
+    }
+}
+
+#ifdef STROKEENGINE_RECORDER
+void StrokeEngine::_record(uint8_t type, uint8_t flags, int32_t index, 
+        int32_t data0, int32_t data1, int32_t data2, int32_t data3) {
+    sessionEvent event;
+    event.timestamp = micros();
+    event.type = type;
+    event.flags = flags;
+    event.reserved = 0;
+    event.index = index;
+    event.data[0] = data0;
+    event.data[1] = data1;
+    event.data[2] = data2;
+    event.data[3] = data3;
+
+    // Setters, the streaming feeder and the motion tasks all record
+    portENTER_CRITICAL(&recorderMux);
+    if (_recording) {
+        _recorder.record(event);
+    }
+    portEXIT_CRITICAL(&recorderMux);
+}
+#endif
+
+void StrokeEngine::_telemetryTask() {
+    telemetryRecord record;
+
+    while(1) { // infinite loop
+
+        // Hand every queued record to the callback, however long it takes
+        while (_telemetry.pop(record)) {
+            if (_callbackTelemetry != NULL) {
+                _callbackTelemetry(record.position, record.speed, 
+                    (record.clipping & (TELEMETRY_CLIP_SPEED | TELEMETRY_CLIP_ACCELERATION)) != 0);
+            }
+        }
+
+        // Sleep until the next record is queued
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+bool StrokeEngine::_deferMove(pendingMove move, float speed) {
+    // Keep the move for the stopping task while the axis decelerates
+    bool deferred = false;
+    portENTER_CRITICAL(&stopMux);
+    if (_state == STOPPING) {
+        _pendingMove = move;
+        _pendingSpeed = speed;
+        deferred = true;
+    }
+    portEXIT_CRITICAL(&stopMux);
+    return deferred;
+}
+
+void StrokeEngine::_startMove(pendingMove move, float speed) {
+    // Set feedrate for safe move 
+    // Constrain speed between 1 step/sec and _maxStepPerSecond
+    servo->setSpeedInHz(constrain(speed * _motor->stepsPerMillimeter, 1, _maxStepPerSecond));
+    servo->setAcceleration(_maxStepAcceleration / 10);
+
+    switch (move) {
+        case PENDING_MAX:
+            servo->moveTo(_maxStep);
+
+            // Send telemetry data
+            _pushTelemetry(float(_maxStep / _motor->stepsPerMillimeter), speed, 
+                float(_maxStepAcceleration / 10 / _motor->stepsPerMillimeter));
+            break;
+
+        case PENDING_MIN:
+            servo->moveTo(_minStep);
+
+            // Send telemetry data
+            _pushTelemetry(float(_minStep / _motor->stepsPerMillimeter), speed, 
+                float(_maxStepAcceleration / 10 / _motor->stepsPerMillimeter));
+            break;
+
+        case PENDING_DEPTH:
+            // Set new state
+            _state = SETUPDEPTH;
+
+            // move to current depth position
+            _setupDepths();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void StrokeEngine::_completeStop() {
+    // A start, disable or homing in the meantime supersedes the stop
+    portENTER_CRITICAL(&stopMux);
+    bool stopped = (_state == STOPPING);
+    pendingMove move = stopped ? _pendingMove : PENDING_NONE;
+    float speed = _pendingSpeed;
+    if (stopped) {
+        _state = READY;
+    }
+    _pendingMove = PENDING_NONE;
+    portEXIT_CRITICAL(&stopMux);
+
+    if (stopped) {
         // Send telemetry data
-        if (_callbackTelemetry != NULL) {
-            _callbackTelemetry(position, speed, clipping);
+        _pushTelemetry(float(servo->getCurrentPosition() / _motor->stepsPerMillimeter), 0.0);
+
+        // Issue a move requested while stopping
+        _startMove(move, speed);
+
+#ifdef DEBUG_TALKATIVE
+        Serial.println("Motion stopped");
+        Serial.println("Stroke Engine State: " + verboseState[_state]);
+#endif
+    }
+
+    xEventGroupSetBits(_stopEvents, STOP_EVENT_IDLE);
+
+    // Call notification callback, if it was defined.
+    if (stopped && (_callbackStopped != NULL)) {
+        _callbackStopped();
+    }
+}
+
+void StrokeEngine::_stoppingTask() {
+    while(1) { // infinite loop
+
+        // Sleep until stopMotion() hands over a decelerating axis
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Sleep for the remaining deceleration at full acceleration, FastAccelStepper 
+        // may need a little longer, so look again after that
+        while (servo->isRunning() && (_state == STOPPING)) {
+            uint32_t speed = abs(servo->getCurrentSpeedInMilliHz());
+            TickType_t ticks = (speed / max(_maxStepAcceleration, 1)) / portTICK_PERIOD_MS;
+            vTaskDelay(max(ticks, TickType_t(1)));
         }
+
+        _completeStop();
     }
 }
 
@@ -1159,11 +1960,8 @@ void StrokeEngine::_setupDepths() {
     servo->moveTo(depth);
 
     // Send telemetry data
-    if (_callbackTelemetry != NULL) {
-        _callbackTelemetry(float(depth / _motor->stepsPerMillimeter), 
-            float(servo->getSpeedInMilliHz() * 1000 / _motor->stepsPerMillimeter), 
-            false);
-    } 
+    _pushTelemetry(float(depth / _motor->stepsPerMillimeter), 
+        float(servo->getSpeedInMilliHz() * 1000 / _motor->stepsPerMillimeter));
 
 #ifdef DEBUG_TALKATIVE
     Serial.println("setup new depth: " + String(depth));
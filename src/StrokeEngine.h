@@ -12,14 +12,37 @@
 #pragma once
 
 #include <Arduino.h>
+#include <StepperBackend.h>
 #include <pattern.h>
 #include <streaming.h>
+#include <SPSCQueue.h>
+#include <SeqLock.h>
+#include <MotionStats.h>
+#include <SessionRecorder.h>
 
 // Debug Levels
 //#define DEBUG_TALKATIVE             // Show debug messages from the StrokeEngine on Serial
 //#define DEBUG_STROKE                // Show debug messaged for each individual stroke on Serial
 #define DEBUG_CLIPPING              // Show debug messages when motions violating the machine 
                                     // physics are commanded
+//#define STROKEENGINE_STATS          // Collect timing and clipping statistics of the motion tasks, 
+                                    // see getStats(). Costs a few µs per move when enabled.
+//#define STROKEENGINE_RECORDER       // Record the last SESSION_RECORDER_DEPTH events of a session for 
+                                    // replay, see exportSession(). Needs 28 bytes RAM per event.
+
+// Motion Scheduling
+#define PAUSE_POLL_MS       10      // Interval in ms a pattern is queried again while it requests
+                                    // a pause by returning skip = true
+#define MOTION_LOOKAHEAD    2       // Number of strokes precomputed while the current stroke is 
+                                    // running. Must be at least 1.
+#define STOP_EVENT_IDLE     0x01    // Event bit set while no stopMotion() is decelerating the axis
+#define REPLAN_INTERVAL_MS  50      // Minimum time between two mid-stroke re-plans requested with
+                                    // applyNow = true. Requests in between are merged.
+
+// Telemetry
+#define TELEMETRY_QUEUE_DEPTH   32  // Records buffered between the motion task and the telemetry 
+                                    // consumer. Must be a power of two.
+#define TELEMETRY_NO_PATTERN    0xFF    // Pattern id of records not generated by a pattern
 
 /**************************************************************************/
 /*!
@@ -84,16 +107,87 @@ typedef enum {
   READY,             //!< Servo is energized and knows it position. Not running.
   PATTERN,           //!< Stroke Engine is running and servo is moving according to defined pattern.
   SETUPDEPTH,        //!< Interactive adjustment mode to setup depth and stroke
-  STREAMING          //!< Tracks the depth-position whenever depth is updated.
+  STREAMING,         //!< Tracks the depth-position whenever depth is updated.
+  STOPPING           //!< Decelerating after stopMotion(). Goes to READY at standstill.
 } ServoState;
 
+/**************************************************************************/
+/*!
+  @brief  Flags of telemetryRecord.clipping telling which limit a move violated
+*/
+/**************************************************************************/
+typedef enum {
+  TELEMETRY_CLIP_SPEED = 0x01,          //!< Speed was reduced to the maximum speed
+  TELEMETRY_CLIP_ACCELERATION = 0x02,   //!< Acceleration was reduced to the maximum acceleration
+  TELEMETRY_CLIP_POSITION = 0x04        //!< Target was constrained to the motion envelope
+} telemetryClipping;
+
+/**************************************************************************/
+/*!
+  @brief  Telemetry of a single move, written by the task commanding it.
+*/
+/**************************************************************************/
+typedef struct {
+  uint32_t timestamp;         /*> micros() when the move was commanded */
+  int32_t index;              /*> Stroke index of a pattern or streaming move, -1 for manual moves */
+  float position;             /*> Target position in mm */
+  float speed;                /*> Top speed in mm/s */
+  float acceleration;         /*> Acceleration in mm/s², 0 if unknown */
+  uint8_t clipping;           /*> telemetryClipping flags */
+  uint8_t pattern;            /*> Pattern index, TELEMETRY_NO_PATTERN for streaming and manual moves */
+} telemetryRecord;
+
+/**************************************************************************/
+/*!
+  @brief  Snapshot of the parameters published by the set-functions. The 
+  motion task copies it at the start of each iteration without waiting for 
+  a mutex and hands changed values to the pattern.
+*/
+/**************************************************************************/
+typedef struct {
+  float timeOfStroke;         /*> Time of a full stroke in s */
+  int depth;                  /*> Depth in steps */
+  int stroke;                 /*> Stroke in steps */
+  float sensation;            /*> Sensation in [-100, 100] */
+  int maxStepPerSecond;       /*> Speed limit in steps/s */
+  int maxStepAcceleration;    /*> Acceleration limit in steps/s² */
+} motionSettings;
+
+/**************************************************************************/
+/*!
+  @brief  How changes of depth, stroke, speed and sensation are ramped, see 
+  StrokeEngine::setRamp()
+*/
+/**************************************************************************/
+typedef enum {
+  RAMP_NONE,          //!< Parameters jump to the new value with the next stroke
+  RAMP_TIME,          //!< Parameters ramp to the new value over a time in seconds
+  RAMP_STROKES        //!< Parameters ramp to the new value over a number of strokes
+} rampMode;
+
+/**************************************************************************/
+/*!
+  @brief  Counters of parameter updates. Updates received minus applied 
+  is the number of updates merged into a later one before the motion task 
+  saw them. Re-plans requested minus executed were merged by the rate limit
+  or made obsolete by the next stroke.
+*/
+/**************************************************************************/
+typedef struct {
+  uint32_t received;          /*> Calls of the set-functions */
+  uint32_t applied;           /*> Snapshots taken over by the motion task */
+  uint32_t replanRequests;    /*> Updates with applyNow = true while running a pattern */
+  uint32_t replans;           /*> Mid-stroke re-plans executed */
+} updateCounters;
+
 // Verbose strings of states for debugging purposes
 static String verboseState[] = {
   "[0] Servo disabled",
   "[1] Servo ready",
   "[2] Servo pattern running",
   "[3] Servo setup depth",
-  "[4] Servo position streaming"
+  "[4] Servo position streaming",
+  "[5] Servo stopping"
 };
 
 /**************************************************************************/
@@ -116,6 +210,16 @@ class StrokeEngine {
         /**************************************************************************/
         void begin(machineGeometry *physics, motorProperties *motor);
 
+        /**************************************************************************/
+        /*!
+          @brief  Initializes StrokeEngine with an alternative step generator like
+          the VirtualStepper. The pins in motorProperties are not used. 
+          StrokeEngine is in state UNDEFINED
+          @param backend Step generator the StrokeEngine commands all motions to.
+        */
+        /**************************************************************************/
+        void begin(machineGeometry *physics, motorProperties *motor, StepperBackend *backend);
+
         /**************************************************************************/
         /*!
           @brief  Set the speed of a stroke. Speed is given in Strokes per Minute
@@ -174,15 +278,87 @@ class StrokeEngine {
 
         /**************************************************************************/
         /*!
-          @brief  Set the sensation of a pattern. Sensation is an additional 
-          parameter a pattern may use to alter its behaviour. Settings takes 
-          effect with next stroke, or after calling applyNewSettingsNow().
-          @param sensation  Sensation in [a.u.]. Is constrained from -100 to 100  
-                        with 0 beeing assumed as neutral.
-          @param applyNow Set to true if changes should take effect immediately 
+          @brief  Appends a point to the streaming buffer. In state STREAMING the 
+          points are executed one after another. Lock-free, it never blocks the 
+          streaming task. Must only be called from one task at a time. If the 
+          buffer is full the new point is dropped and the queued points are 
+          kept. Up to version 0.3 the oldest point was overwritten instead.
+          @param position Target position in [%] of stroke, 0 is depth - stroke 
+                        and 100 is depth
+          @param time   Time in [ms] the move to position should take
+          @param replace Set to true to discard all points not yet executed
+          @return TRUE if the point was accepted, FALSE if the buffer is full
+        */
+        /**************************************************************************/
+        bool appendToStreaming(unsigned int position, unsigned int time, boolean replace);
+
+        /**************************************************************************/
+        /*!
+          @brief  Appends several points to the streaming buffer at once. Like 
+          appendToStreaming() for a single point this is lock-free and never 
+          blocks the streaming task. Must only be called from one task at a time.
+          @param movements Array of points, each holding a position in [%] of 
+                        stroke and the time in [ms] to get there
+          @param count  Number of points in movements
+          @param replace Set to true to discard all points not yet executed
+          @return Number of points accepted. Less than count if the buffer is full.
+        */
+        /**************************************************************************/
+        size_t appendToStreaming(const Movement *movements, size_t count, boolean replace = false);
+
+        /**************************************************************************/
+        /*!
+          @brief  Appends a point with an absolute timestamp to the streaming buffer.
+          The move is planned with the time that is left until the timestamp when 
+          it is executed, rather than a nominal duration. This compensates queueing 
+          delays and keeps the motion in sync with the source media over long 
+          sessions. Align the clock with syncStreamingClock() first.
+          @param position Target position in [%] of stroke, 0 is depth - stroke 
+                        and 100 is depth
+          @param timestamp Time in [ms] on the streaming clock at which position 
+                        must be reached
+          @param replace Set to true to discard all points not yet executed
+          @return TRUE if the point was accepted, FALSE if the buffer is full
+        */
+        /**************************************************************************/
+        bool appendToStreamingAt(unsigned int position, unsigned long timestamp, boolean replace);
+
+        /**************************************************************************/
+        /*!
+          @brief  Aligns the streaming clock used by appendToStreamingAt() with the
+          source, e.g. the playback position of a video. Call it on start of 
+          playback and whenever the source seeks or drifts.
+          @param timestamp Current time of the source in [ms]
+        */
+        /**************************************************************************/
+        void syncStreamingClock(unsigned long timestamp);
+
+        /**************************************************************************/
+        /*!
+          @brief  Number of points that can be appended to the streaming buffer 
+          before it is full. Allows a feeder to fill the buffer in batches without
+          ever overflowing it.
+          @return Free slots in the streaming buffer
+        */
+        /**************************************************************************/
+        size_t getStreamingFreeSlots();
+
+        /**************************************************************************/
+        /*!
+          @brief  Capacity of the streaming buffer. Set at compile time with 
+          #define STREAMING_QUEUE_DEPTH
+          @return Number of points the streaming buffer holds
         */
         /**************************************************************************/
-        void appendToStreaming(unsigned int position, unsigned int time, boolean replace);
+        size_t getStreamingQueueDepth();
+
+        /**************************************************************************/
+        /*!
+          @brief  Number of points rejected because the streaming buffer was full.
+          @return Dropped points since begin()
+        */
+        /**************************************************************************/
+        unsigned long getStreamingDropCount();
 
         /**************************************************************************/
         /*!
@@ -248,12 +424,35 @@ class StrokeEngine {
 
         /**************************************************************************/
         /*!
-          @brief  Stops the motion with MAX_ACCEL and deletes the stroking task. Is
-          in state READY afterwards.
+          @brief  Stops the motion with MAX_ACCEL and suspends the motion task. 
+          Returns immediately in state STOPPING. A task goes to READY once the 
+          axis has come to a standstill, then calls the callback registered with
+          registerStopCallback() and sets STOP_EVENT_IDLE. Only valid in states 
+          PATTERN, SETUPDEPTH and STREAMING.
         */
         /**************************************************************************/
         void stopMotion();
 
+        /**************************************************************************/
+        /*!
+          @brief  Wait until a stop started by stopMotion() has completed. The 
+          calling task sleeps on an event group and does not use any CPU.
+          @param ticksToWait maximum time to wait in FreeRTOS ticks
+          @return TRUE if no stop is in progress, FALSE on timeout
+        */
+        /**************************************************************************/
+        bool waitForStop(TickType_t ticksToWait = portMAX_DELAY);
+
+        /**************************************************************************/
+        /*!
+          @brief  Register a callback function that is called whenever a stop 
+          started by stopMotion() has completed and StrokeEngine is in state READY.
+          It runs in the task supervising the stop and must not block.
+          @param callbackStopped Function must be of type: void callbackStopped()
+        */
+        /**************************************************************************/
+        void registerStopCallback(void(*callbackStopped)());
+
         /**************************************************************************/
         /*!
           @brief  Enable the servo/stepper and do the homing procedure. Drives towards
@@ -292,7 +491,8 @@ class StrokeEngine {
         /*!
           @brief  In state PATTERN, SETUPDEPTH and READY this 
           moves the endeffector to TRAVEL. Can be used for adjustments. Stops any 
-          running pattern and ends in state READY.
+          running pattern and ends in state READY. Does not block: while the 
+          axis decelerates the move is kept and started once the stop completed.
           @param speed  Speed in mm/s used for driving to max. 
                         Defaults to 10.0 mm/s
           @return TRUE on success, FALSE if state does not allow this.
@@ -304,7 +504,8 @@ class StrokeEngine {
         /*!
           @brief  In state PATTERN, SETUPDEPTH and READY this 
           moves the endeffector to 0. Can be used for adjustments. Stops any running
-          pattern and ends in state READY.
+          pattern and ends in state READY. Does not block: while the axis 
+          decelerates the move is kept and started once the stop completed.
           @param speed  Speed in mm/s used for driving to min. 
                         Defaults to 10.0 mm/s
           @return TRUE on success, FALSE if state does not allow this.
@@ -317,7 +518,8 @@ class StrokeEngine {
           @brief  In state PATTERN and READY this moves the endeffector
           to DEPTH and enters state SETUPDEPTH. Follows the DEPTH postion 
           whenever setDepth() is called. Can be used for adjustments. Stops any running
-          pattern. 
+          pattern. Does not block: while the axis decelerates the state is STOPPING
+          and SETUPDEPTH is entered once the stop completed.
           @param speed  Speed in mm/s used for driving to min. 
                         Defaults to 10.0 mm/s
           @param fancy  In fancy mode sensation allows to adjust both, depth and 
@@ -364,7 +566,7 @@ class StrokeEngine {
         */
         /**************************************************************************/
         unsigned int getNumberOfPattern() { 
-          return patternTableSize; 
+          return PatternRegistry::size(); 
         };
 
         /**************************************************************************/
@@ -400,6 +602,26 @@ class StrokeEngine {
         */
         /**************************************************************************/
         float getMaxAcceleration();
+
+        /**************************************************************************/
+        /*!
+          @brief   Limits the jerk of all pattern and streaming moves. Moves then 
+          follow an S-curve instead of a trapezoid: acceleration ramps up and down 
+          instead of jumping, which reduces mechanical shock and audible knock at 
+          the stroke ends. Each move takes a bit longer, about maxAcceleration / jerk. 
+          Patterns may request a lower jerk for individual moves.
+          @param maxJerk maximum jerk in mm/s³. 0 disables the limit (default).
+        */
+        /**************************************************************************/
+        void setMaxJerk(float maxJerk);
+
+        /**************************************************************************/
+        /*!
+          @brief  Get the current set maximum jerk
+          @return maximum jerk in mm/s³. 0 if disabled.
+        */
+        /**************************************************************************/
+        float getMaxJerk();
         
         /**************************************************************************/
         /*!
@@ -423,12 +645,132 @@ class StrokeEngine {
           about StrokeEngine. The provided function will be called whenever a motion 
           is executed by a manual command or by a pattern. The returned values are the
           target position of this move, its top speed and wether clipping occurred. 
+          The callback runs in a low priority task on core 0 that drains the 
+          telemetry buffer, so a slow callback never delays the motion. If it falls 
+          behind by more than TELEMETRY_QUEUE_DEPTH moves, records are dropped.
+          Don't use readTelemetry() while a callback is registered.
           @param callbackTelemetry Function must be of type: 
           void callbackTelemetry(float position, float speed, bool clipping)
         */
         /**************************************************************************/
         void registerTelemetryCallback(void(*callbackTelemetry)(float, float, bool));
 
+        /**************************************************************************/
+        /*!
+          @brief  Pull the oldest record from the telemetry buffer. Lock-free, it 
+          never blocks the motion task. Must only be called from one task at a 
+          time and not together with registerTelemetryCallback().
+          @param record receives the record
+          @return TRUE if a record was read, FALSE if the buffer is empty
+        */
+        /**************************************************************************/
+        bool readTelemetry(telemetryRecord &record);
+
+        /**************************************************************************/
+        /*!
+          @brief  Number of telemetry records dropped because the consumer did not 
+          keep up and the telemetry buffer was full.
+          @return Dropped records since begin()
+        */
+        /**************************************************************************/
+        unsigned long getTelemetryDropCount();
+
+        /**************************************************************************/
+        /*!
+          @brief  Counters of parameter updates. Bursts of set-function calls are
+          merged: the motion task only takes over the latest snapshot once per 
+          iteration, and re-plans with applyNow = true are limited to one every 
+          REPLAN_INTERVAL_MS.
+          @return Counters since begin() or the last resetUpdateCounters()
+        */
+        /**************************************************************************/
+        updateCounters getUpdateCounters();
+
+        /**************************************************************************/
+        /*!
+          @brief  Ramp depth, stroke, speed and sensation to new values instead of
+          jumping. The motion task hands intermediate values to the pattern at 
+          every stroke, so large changes don't cause clipping or crash avoidance.
+          Speed ramps evenly in strokes per minute. The values change in steps 
+          whenever the motion task wakes up for a new move: a ramp over n strokes
+          takes 2n steps, a ramp over time reaches its target with the first move
+          starting after the time has passed. A change during a ramp starts a 
+          new ramp from the current intermediate values. Starting a motion or 
+          changing the pattern applies the values without ramp. Motion limits 
+          are never ramped.
+          @param mode   RAMP_NONE, RAMP_TIME or RAMP_STROKES
+          @param length Length of the ramp in seconds for RAMP_TIME or in strokes
+                        for RAMP_STROKES
+        */
+        /**************************************************************************/
+        void setRamp(rampMode mode, float length);
+
+        /**************************************************************************/
+        /*!
+          @brief  Whether the motion task is ramping parameters to new values.
+          @return TRUE while a ramp is running
+        */
+        /**************************************************************************/
+        bool isRamping();
+
+        /**************************************************************************/
+        /*!
+          @brief  Reset the counters of parameter updates to zero.
+        */
+        /**************************************************************************/
+        void resetUpdateCounters();
+
+        /**************************************************************************/
+        /*!
+          @brief  Statistics of the stroking and streaming task since begin() or 
+          the last resetStats(): histograms of the loop period, the pattern compute 
+          time and the gap between moves, mutex misses and clipping counts. Only 
+          collected if STROKEENGINE_STATS is defined, all zero otherwise. The 
+          snapshot is taken while the motion task runs, so counters may be off 
+          by one move against each other.
+          @return Copy of the statistics
+        */
+        /**************************************************************************/
+        motionStats getStats();
+
+        /**************************************************************************/
+        /*!
+          @brief  Discard all statistics collected so far.
+        */
+        /**************************************************************************/
+        void resetStats();
+
+        /**************************************************************************/
+        /*!
+          @brief  Size of the recorded session as written by exportSession(). 
+          Only recorded if STROKEENGINE_RECORDER is defined.
+          @return Size in bytes, 0 if the recorder is disabled
+        */
+        /**************************************************************************/
+        size_t getSessionSize();
+
+        /**************************************************************************/
+        /*!
+          @brief  Writes the recorded session into a buffer: a sessionFileHeader 
+          followed by the last SESSION_RECORDER_DEPTH events, oldest first. 
+          Setter calls, streamed points, starts and stops, every move a pattern 
+          computed and every move handed to the stepper are recorded. Store 
+          the buffer e.g. on a file system and replay it on a host with the 
+          SessionReplayer. Recording pauses while the session is exported.
+          @param buffer receives the session file
+          @param size size of buffer in bytes, at least getSessionSize()
+          @return Bytes written, 0 if buffer is too small or the recorder is disabled
+        */
+        /**************************************************************************/
+        size_t exportSession(void *buffer, size_t size);
+
+        /**************************************************************************/
+        /*!
+          @brief  Discard the recorded session.
+        */
+        /**************************************************************************/
+        void clearSession();
+
     protected:
         ServoState _state = UNDEFINED;
         motorProperties *_motor;
@@ -438,6 +780,7 @@ class StrokeEngine {
         int _maxStep;
         int _maxStepPerSecond;
         int _maxStepAcceleration;
+        int _maxStepJerk = 0;
         int _patternIndex = 0;
         bool _isHomed = false;
         int _index = 0;
@@ -455,15 +798,90 @@ class StrokeEngine {
         void _sensorlessHomingProcedure();
         static void _strokingImpl(void* _this) { static_cast<StrokeEngine*>(_this)->_stroking(); }
         void _stroking();
+        TickType_t _strokingCycle();        /*> One iteration of the stroking task, returns the ticks to sleep */
         static void _streamingImpl(void* _this) { static_cast<StrokeEngine*>(_this)->_streaming(); }
         void _streaming();
+        TickType_t _streamingCycle();       /*> One iteration of the streaming task, returns the ticks to sleep */
         TaskHandle_t _taskStrokingHandle = NULL;
         TaskHandle_t _taskHomingHandle = NULL;
         TaskHandle_t _taskStreamingHandle = NULL;
+        TaskHandle_t _taskTelemetryHandle = NULL;
+        TaskHandle_t _taskStoppingHandle = NULL;
         SemaphoreHandle_t _patternMutex = xSemaphoreCreateMutex();
-        void _applyMotionProfile(motionParameter* motion);
+        EventGroupHandle_t _stopEvents = xEventGroupCreate();
+        typedef enum {
+            PENDING_NONE,       //!< Nothing to do after a stop
+            PENDING_MAX,        //!< moveToMax() requested while stopping
+            PENDING_MIN,        //!< moveToMin() requested while stopping
+            PENDING_DEPTH       //!< setupDepth() requested while stopping
+        } pendingMove;
+        pendingMove _pendingMove = PENDING_NONE;
+        float _pendingSpeed = 0.0;
+        bool _deferMove(pendingMove move, float speed);
+        void _startMove(pendingMove move, float speed);
+        void _completeStop();
+        static void _stoppingImpl(void* _this) { static_cast<StrokeEngine*>(_this)->_stoppingTask(); }
+        void _stoppingTask();
+        unsigned long _moveDeadline = 0;    /*> micros() at which the motion task needs to act next */
+        unsigned long _blendDeadline = 0;   /*> micros() at which the current move starts decelerating */
+        int _moveTarget = 0;                /*> Target position of the current move in steps */
+        int _moveDirection = 0;             /*> Direction of the current move: 1, -1 or 0 */
+        uint8_t _applyMotionProfile(motionParameter* motion);
+        motionParameter _computeMotion(int index);
+        void _updateActualState();
+        void _preparePattern();
+        void _prepareStreaming();
+        SeqLock<motionSettings> _settings;
+        motionSettings _appliedSettings = motionSettings();     /*> Snapshot the active pattern was last given */
+        uint32_t _settingsApplied = 0;                          /*> Sequence number of _appliedSettings */
+        motionSettings _publishedSettings = motionSettings();   /*> Snapshot last written by a set-function */
+        updateCounters _updates = updateCounters();
+        motionSettings _targetSettings = motionSettings();      /*> Latest snapshot a ramp is heading for */
+        motionSettings _rampFrom = motionSettings();            /*> Values the running ramp started from */
+        rampMode _rampMode = RAMP_NONE;
+        float _rampLength = 0.0;
+        bool _rampActive = false;
+        unsigned long _rampStart = 0;       /*> micros() at the start of the running ramp */
+        int _rampStartIndex = 0;            /*> Stroke index at the start of the running ramp */
+        void _publishSettings(bool applyNow);
+        template <typename T> void _publishSetting(T &setting, T value, bool applyNow);
+        bool _publishSettingsLocked(bool applyNow);     /*> Builds and publishes the snapshot, caller holds settingsMux */
+        void _injectSettings(Pattern *pattern);
+        bool _applySettings();
+        unsigned long _predictMoveDuration(int distance, int speed, int acceleration, float startSpeed);
+        TickType_t _ticksUntilMoveCompletes();
+        TickType_t _ticksUntil(unsigned long deadline);
+        bool _replanAllowed();
+        TickType_t _ticksUntilReplanAllowed();
+        unsigned long _lastReplan = 0;      /*> micros() of the last mid-stroke re-plan */
+        bool _replanned = false;            /*> A re-plan ran within the last REPLAN_INTERVAL_MS */
+        void _notifyMotionTask();
+        motionParameter _lookahead[MOTION_LOOKAHEAD];
+        int _lookaheadHead = 0;
+        int _lookaheadCount = 0;
+        void _fillLookahead(Pattern *pattern);
+        void _clearLookahead();
+        bool _canBlend(Pattern *pattern);
         void(*_callBackHomeing)(bool) = NULL;
         void(*_callbackTelemetry)(float, float, bool) = NULL;
+        void(*_callbackStopped)() = NULL;
+        SPSCQueue<telemetryRecord, TELEMETRY_QUEUE_DEPTH> _telemetry;
+        unsigned long _telemetryDropped = 0;
+        void _pushTelemetry(float position, float speed, float acceleration = 0.0, uint8_t clipping = 0, 
+            int index = -1, uint8_t pattern = TELEMETRY_NO_PATTERN);
+        static void _telemetryImpl(void* _this) { static_cast<StrokeEngine*>(_this)->_telemetryTask(); }
+        void _telemetryTask();
+#ifdef STROKEENGINE_STATS
+        motionStats _stats = motionStats();
+        uint32_t _statsLastLoop = 0;        /*> micros() of the previous motion task iteration, 0 if none */
+        bool _statsMoving = false;          /*> A move was issued since motion started, gaps can be measured */
+#endif
+#ifdef STROKEENGINE_RECORDER
+        SessionRecorder _recorder;
+        volatile bool _recording = true;
+        void _record(uint8_t type, uint8_t flags, int32_t index, 
+            int32_t data0 = 0, int32_t data1 = 0, int32_t data2 = 0, int32_t data3 = 0);
+#endif
         bool _sensorlessHomeing;
         int _homeingSpeed;
         int _homeingPin;
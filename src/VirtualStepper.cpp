@@ -0,0 +1,207 @@
+#include <math.h>
+#include "VirtualStepper.h"
+
+void VirtualStepper::advance(uint32_t micros) {
+    while (micros > 0) {
+        uint32_t step = (micros < _timeStep) ? micros : _timeStep;
+        _integrate(step * 1.0e-6);
+        _time += step;
+        micros -= step;
+    }
+}
+
+int8_t VirtualStepper::setSpeedInHz(uint32_t speed) {
+    // FastAccelStepper rejects a speed of 0
+    if (speed == 0) {
+        return -1;
+    }
+    _pendingSpeed = speed;
+    return 0;
+}
+
+int8_t VirtualStepper::setAcceleration(int32_t acceleration) {
+    if (acceleration <= 0) {
+        return -1;
+    }
+    _pendingAcceleration = acceleration;
+    return 0;
+}
+
+void VirtualStepper::applySpeedAcceleration() {
+    _speed = _pendingSpeed;
+    _acceleration = _pendingAcceleration;
+    _linearAcceleration = _pendingLinearAcceleration;
+}
+
+int8_t VirtualStepper::moveTo(int32_t position) {
+    applySpeedAcceleration();
+    _target = position;
+
+    // Already there and not moving
+    if ((_mode == IDLE) && (position == getCurrentPosition())) {
+        return 0;
+    }
+
+    _mode = TARGET;
+    return 0;
+}
+
+int8_t VirtualStepper::move(int32_t distance) {
+    // Like FastAccelStepper a relative move is relative to the running move's target
+    int32_t base = (_mode == TARGET) ? _target : getCurrentPosition();
+    return moveTo(base + distance);
+}
+
+int8_t VirtualStepper::runForward() {
+    applySpeedAcceleration();
+    _mode = FORWARD;
+    return 0;
+}
+
+int8_t VirtualStepper::runBackward() {
+    applySpeedAcceleration();
+    _mode = BACKWARD;
+    return 0;
+}
+
+void VirtualStepper::stopMove() {
+    if (_mode != IDLE) {
+        _mode = STOPPING;
+    }
+}
+
+void VirtualStepper::forceStopAndNewPosition(int32_t position) {
+    _mode = IDLE;
+    _velocity = 0.0;
+    _position = position;
+    _target = position;
+}
+
+void VirtualStepper::setCurrentPosition(int32_t position) {
+    // shift the coordinate system, a running move keeps its relative target
+    double offset = position - _position;
+    _position += offset;
+    _target += int32_t(lround(offset));
+}
+
+int32_t VirtualStepper::getCurrentPosition() {
+    return int32_t(lround(_position));
+}
+
+void VirtualStepper::_integrate(double dt) {
+    if (_mode == IDLE) {
+        _lastAcceleration = 0.0;
+        return;
+    }
+
+    double a = double(_acceleration);
+    double vMax = double(_speed);
+    double vDesired = 0.0;
+
+    // Jerk limit: reaching acceleration a after a ramp of N steps from standstill 
+    // means N = a³ / 6j²
+    double jerk = 0.0;
+    if (_linearAcceleration > 0) {
+        jerk = sqrt((a * a * a) / (6.0 * _linearAcceleration));
+    }
+
+    switch (_mode) {
+        case FORWARD:
+            vDesired = vMax;
+            break;
+
+        case BACKWARD:
+            vDesired = -vMax;
+            break;
+
+        case TARGET: {
+            double remaining = double(_target) - _position;
+
+            // Arrived: snap to the target once the residual motion is below one step
+            if ((fabs(remaining) <= 0.5) && (fabs(_velocity) <= a * dt)) {
+                _position = _target;
+                _velocity = 0.0;
+                _mode = IDLE;
+                return;
+            }
+
+            double direction = (remaining > 0.0) ? 1.0 : -1.0;
+            double brakingDistance = (_velocity * _velocity) / (2.0 * a);
+
+            // Ramping the acceleration up and down costs about a/j of full deceleration
+            if (jerk > 0.0) {
+                brakingDistance += 0.5 * fabs(_velocity) * a / jerk;
+            }
+
+            // Decelerate if the target is within braking distance, otherwise
+            // accelerate towards the target with top speed. Moving in the wrong
+            // direction is handled by the same rule, as vDesired has the opposite sign.
+            if ((_velocity * direction > 0.0) && (fabs(remaining) <= brakingDistance)) {
+                vDesired = 0.0;
+            } else {
+                vDesired = direction * vMax;
+            }
+            break;
+        }
+
+        case STOPPING:
+        default:
+            vDesired = 0.0;
+            break;
+    }
+
+    // Approach the desired speed with the set acceleration
+    double dv = vDesired - _velocity;
+    double dvMax = a * dt;
+    if (dv > dvMax) {
+        dv = dvMax;
+    } else if (dv < -dvMax) {
+        dv = -dvMax;
+    }
+
+    // With a jerk limit the acceleration is ramped towards the commanded value. 
+    // It is reduced early enough to arrive at the desired speed with zero acceleration.
+    if (jerk > 0.0) {
+        double error = vDesired - _velocity;
+        double aTarget = sqrt(2.0 * jerk * fabs(error));
+        if (aTarget > a) {
+            aTarget = a;
+        }
+        if (aTarget > fabs(error) / dt) {
+            aTarget = fabs(error) / dt;
+        }
+        aTarget = (error > 0.0) ? aTarget : -aTarget;
+
+        double da = aTarget - _lastAcceleration;
+        double daMax = jerk * dt;
+        if (da > daMax) {
+            da = daMax;
+        } else if (da < -daMax) {
+            da = -daMax;
+        }
+        dv = (_lastAcceleration + da) * dt;
+    }
+
+    double velocity = _velocity + dv;
+    _position += 0.5 * (_velocity + velocity) * dt;
+    _velocity = velocity;
+
+    // Track peak values
+    if (fabs(_velocity) > _peakSpeed) {
+        _peakSpeed = fabs(_velocity);
+    }
+    double acceleration = dv / dt;
+    if (fabs(acceleration) > _peakAcceleration) {
+        _peakAcceleration = fabs(acceleration);
+    }
+    if (fabs(acceleration - _lastAcceleration) / dt > _peakJerk) {
+        _peakJerk = fabs(acceleration - _lastAcceleration) / dt;
+    }
+    _lastAcceleration = acceleration;
+
+    // A stopping motor is done once it reached standstill
+    if ((_mode == STOPPING) && (_velocity == 0.0)) {
+        _target = getCurrentPosition();
+        _mode = IDLE;
+    }
+}
@@ -0,0 +1,122 @@
+/**
+ *   Virtual Stepper Backend of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "StepperBackend.h"
+
+/**************************************************************************/
+/*!
+  @class VirtualStepper
+  @brief  Deterministic stepper simulation. Integrates the trapezoidal
+          motion profiles the StrokeEngine commands in simulated time,
+          without any hardware or timer attached. Time only passes when
+          advance() is called, so every run with the same commands gives
+          bit-identical results. Like FastAccelStepper, speed and
+          acceleration take effect with the next move or after calling
+          applySpeedAcceleration().
+*/
+/**************************************************************************/
+class VirtualStepper : public StepperBackend {
+
+    public:
+        //! Constructor
+        /*!
+          @param timeStepMicros integration time step in µs. Smaller steps are
+                        more accurate, but slower to simulate.
+        */
+        VirtualStepper(uint32_t timeStepMicros = 10) : _timeStep(timeStepMicros) {}
+
+        //! Advance the simulated time and integrate the motion
+        /*!
+          @param micros time in µs to advance
+        */
+        void advance(uint32_t micros);
+
+        //! Simulated time since construction
+        /*!
+          @return time in µs
+        */
+        uint64_t now() { return _time; }
+
+        //! Whether the outputs are enabled
+        bool isEnabled() { return _enabled; }
+
+        //! Highest absolute speed seen since the last resetPeaks()
+        /*!
+          @return speed in steps/s
+        */
+        float getPeakSpeed() { return _peakSpeed; }
+
+        //! Highest absolute acceleration seen since the last resetPeaks()
+        /*!
+          @return acceleration in steps/s²
+        */
+        float getPeakAcceleration() { return _peakAcceleration; }
+
+        //! Highest absolute jerk seen since the last resetPeaks(). A trapezoid 
+        //! changes acceleration within one time step, which shows as acceleration / time step.
+        /*!
+          @return jerk in steps/s³
+        */
+        float getPeakJerk() { return _peakJerk; }
+
+        //! Reset peak speed, acceleration and jerk tracking
+        void resetPeaks() { _peakSpeed = 0.0; _peakAcceleration = 0.0; _peakJerk = 0.0; }
+
+        void enableOutputs() { _enabled = true; }
+        void disableOutputs() { _enabled = false; }
+        int8_t setSpeedInHz(uint32_t speed);
+        int8_t setAcceleration(int32_t acceleration);
+        void setLinearAcceleration(uint32_t steps) { _pendingLinearAcceleration = steps; }
+        void applySpeedAcceleration();
+        int8_t moveTo(int32_t position);
+        int8_t move(int32_t distance);
+        int8_t runForward();
+        int8_t runBackward();
+        void stopMove();
+        void forceStopAndNewPosition(int32_t position);
+        void setCurrentPosition(int32_t position);
+        bool isRunning() { return _mode != IDLE; }
+        int32_t getCurrentPosition();
+        int32_t getCurrentSpeedInMilliHz() { return int32_t(_velocity * 1000.0); }
+        uint32_t getSpeedInMilliHz() { return _pendingSpeed * 1000; }
+        uint32_t getAcceleration() { return _pendingAcceleration; }
+
+    protected:
+        typedef enum {
+            IDLE,           //!< Standstill
+            TARGET,         //!< Moving to _target
+            FORWARD,        //!< Running towards positive positions
+            BACKWARD,       //!< Running towards negative positions
+            STOPPING        //!< Decelerating to standstill
+        } motionMode;
+
+        motionMode _mode = IDLE;
+        uint32_t _timeStep;
+        uint64_t _time = 0;
+        bool _enabled = false;
+        double _position = 0.0;
+        double _velocity = 0.0;
+        int32_t _target = 0;
+        uint32_t _speed = 0;
+        uint32_t _acceleration = 0;
+        uint32_t _pendingSpeed = 0;
+        uint32_t _pendingAcceleration = 0;
+        uint32_t _linearAcceleration = 0;
+        uint32_t _pendingLinearAcceleration = 0;
+        double _lastAcceleration = 0.0;
+        float _peakSpeed = 0.0;
+        float _peakAcceleration = 0.0;
+        float _peakJerk = 0.0;
+        void _integrate(double dt);
+};
@@ -0,0 +1,70 @@
+/**
+ *   Patterns of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine 
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "pattern.h"
+
+/**************************************************************************/
+/*
+  Instances of all built-in patterns. They exist exactly once and are shared 
+  by StrokeEngine and the main program. Please include any new built-in 
+  pattern here and in builtinPatterns[] below. Custom patterns can also be 
+  added from the main program with REGISTER_PATTERN().
+*/
+/**************************************************************************/
+static SimpleStroke simpleStroke("Simple Stroke");
+static TeasingPounding teasingPounding("Teasing or Pounding");
+static RoboStroke roboStroke("Robo Stroke");
+static HalfnHalf halfnHalf("Half'n'Half");
+static Deeper deeper("Deeper");
+static StopNGo stopNGo("Stop'n'Go");
+static Insist insist("Insist");
+
+// Addresses of static objects are known at compile time, so this table is 
+// constant initialized before any constructor runs.
+static Pattern * const builtinPatterns[] = { 
+  &simpleStroke,
+  &teasingPounding,
+  &roboStroke,
+  &halfnHalf,
+  &deeper,
+  &stopNGo,
+  &insist
+  // <-- insert your new pattern instance here!
+ };
+
+static const unsigned int builtinPatternCount = sizeof(builtinPatterns) / sizeof(builtinPatterns[0]);
+
+// Zero initialized before static constructors run, so REGISTER_PATTERN() is safe in any translation unit
+static Pattern *customPatterns[MAX_CUSTOM_PATTERNS];
+static unsigned int customPatternCount = 0;
+
+Pattern *PatternRegistry::get(unsigned int index) {
+    if (index < builtinPatternCount) {
+        return builtinPatterns[index];
+    }
+    index -= builtinPatternCount;
+    if (index < customPatternCount) {
+        return customPatterns[index];
+    }
+    return NULL;
+}
+
+unsigned int PatternRegistry::size() {
+    return builtinPatternCount + customPatternCount;
+}
+
+bool PatternRegistry::add(Pattern *pattern) {
+    if ((pattern == NULL) || (customPatternCount >= MAX_CUSTOM_PATTERNS)) {
+        return false;
+    }
+    customPatterns[customPatternCount++] = pattern;
+    return true;
+}
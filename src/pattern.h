@@ -12,11 +12,9 @@
 #pragma once
 
 #include <Arduino.h>
-#include <StrokeEngine.h>
 #include <math.h>
 #include "PatternMath.h"
-
-#define DEBUG_PATTERN                 // Print some debug informations over Serial
+#include "MotionPlanner.h"
 
 #ifndef STRING_LEN
   #define STRING_LEN           64     // Bytes used to initialize char array. No path, topic, name, etc. should exceed this value
@@ -25,7 +23,7 @@
 /**************************************************************************/
 /*!
   @brief  struct to return all parameters FastAccelStepper needs to calculate
-  the trapezoidal profile.
+  the trapezoidal or jerk-limited S-curve profile.
 */
 /**************************************************************************/
 typedef struct {
@@ -33,8 +31,40 @@ typedef struct {
     int speed;          //!< Speed of a move in Steps/second 
     int acceleration;   //!< Acceleration to get to speed or halt 
     bool skip;          //!< no valid stroke, skip this set an query for the next --> allows pauses between strokes
+    int jerk;           //!< Jerk limit of a move in Steps/second³ for an S-curve profile. 0 gives a trapezoid.
 } motionParameter;
 
+/**************************************************************************/
+/*!
+  @brief  Enum selecting how consecutive motions of a pattern are joined.
+*/
+/**************************************************************************/
+typedef enum {
+  TRAJECTORY_STOP,    //!< Every target is approached as an isolated trapezoid and the axis comes to a full stop
+  TRAJECTORY_BLEND    //!< Consecutive targets in the same direction are blended without stopping in between
+} trajectoryMode;
+
+
+/**************************************************************************/
+/*!
+  @brief  Identifies the built-in pattern classes, so the stroking task can 
+  call their nextTarget() directly instead of through the vtable.
+*/
+/**************************************************************************/
+typedef enum {
+  PATTERN_CUSTOM,               //!< Any pattern not listed here, dispatched virtually
+  PATTERN_SIMPLE_STROKE,
+  PATTERN_TEASING_POUNDING,
+  PATTERN_ROBO_STROKE,
+  PATTERN_HALF_N_HALF,
+  PATTERN_DEEPER,
+  PATTERN_STOP_N_GO,
+  PATTERN_INSIST,
+  PATTERN_KEYFRAME,
+  PATTERN_SEQUENCE,
+  PATTERN_PLAYER
+} patternType;
+
 
 /**************************************************************************/
 /*!
@@ -89,6 +119,12 @@ class Pattern {
         */
         char *getName() { return _name; }
 
+        //! Renames a pattern, e.g. after loading its data from a file
+        /*! 
+          @param str String containing the new name. Truncated to STRING_LEN - 1 characters.
+        */
+        void setName(const char *str) { strncpy(_name, str, STRING_LEN - 1); _name[STRING_LEN - 1] = '\0'; }
+
         //! Calculate the position of the next stroke based on the various parameters
         /*! 
           @param index index of a stroke. Increments with every new stroke. 
@@ -107,19 +143,44 @@ class Pattern {
         */
         virtual void setSpeedLimit(unsigned int maxSpeed, unsigned int maxAcceleration, unsigned int stepsPerMM) { _maxSpeed = maxSpeed; _maxAcceleration = maxAcceleration; _stepsPerMM = stepsPerMM; } 
 
+        //! Tells the StrokeEngine whether nextTarget() may be called ahead of time
+        /*! 
+          @return True, if strokes may be precomputed while the previous stroke is still running.
+                  Patterns depending on millis() should return false.
+        */
+        bool allowsLookahead() { return _allowLookahead; }
+
+        //! Tells the StrokeEngine how consecutive motions are joined
+        /*! 
+          @return TRAJECTORY_STOP if the axis stops at every target, TRAJECTORY_BLEND if 
+                  targets continuing in the same direction are passed through without stopping.
+        */
+        trajectoryMode getTrajectoryMode() { return _trajectoryMode; }
+
+        //! Built-in class of this pattern, used by dispatchNextTarget()
+        /*! 
+          @return type id of a built-in pattern, PATTERN_CUSTOM otherwise
+        */
+        patternType getType() { return _type; }
+
     protected:
-        int _stroke;
-        int _depth;
-        float _timeOfStroke;
+        int _stroke = 0;
+        int _depth = 0;
+        float _timeOfStroke = 0.0;
         float _sensation = 0.0;
         int _index = -1;
         char _name[STRING_LEN]; 
-        motionParameter _nextMove = {0, 0, 0, false};
+        motionParameter _nextMove = {0, 0, 0, false, 0};
         int _startDelayMillis = 0;
         int _delayInMillis = 0;
         unsigned int _maxSpeed = 0;
         unsigned int _maxAcceleration = 0;
         unsigned int _stepsPerMM = 0;
+        bool _allowLookahead = true;
+        int _holdIndex = -1;
+        trajectoryMode _trajectoryMode = TRAJECTORY_STOP;
+        TrapezoidProfile _profile;      //!< Precomputed fixed point speed & acceleration factors
+        patternType _type = PATTERN_CUSTOM;
 
         /*!
           @brief Start a delay timer which can be polled by calling _isStillDelayed(). 
@@ -147,6 +208,28 @@ class Pattern {
             return (millis() > (_startDelayMillis + _delayInMillis)) ? false : true; 
         }
 
+        /*! 
+          @brief Hold the position at a stroke which does not move, like a pause in a 
+          recorded sequence. The hold starts when the index is queried the first time.
+          Patterns using it should not allow lookahead, as this would start the hold early.
+          Uses internally the millis()-function.
+          @param index index of the stroke
+          @param holdInMillis duration of the hold in milliseconds
+          @return True, while the hold is running, false once it has expired.
+        */
+        bool _isHolding(unsigned int index, int holdInMillis) {
+            if (_holdIndex != int(index)) {
+                _holdIndex = index;
+                _updateDelay(holdInMillis);
+                _startDelay();
+            }
+            if (_isStillDelayed()) {
+                return true;
+            }
+            _holdIndex = -1;
+            return false;
+        }
+
 };
 
 /**************************************************************************/
@@ -158,19 +241,20 @@ class Pattern {
 /**************************************************************************/
 class SimpleStroke : public Pattern {
     public:
-        SimpleStroke(const char *str) : Pattern(str) {}
+        SimpleStroke(const char *str) : Pattern(str) { _type = PATTERN_SIMPLE_STROKE; }
 
         void setTimeOfStroke(float speed = 0) { 
              // In & Out have same time, so we need to divide by 2
             _timeOfStroke = 0.5 * speed; 
+            _profile.setTime(_timeOfStroke);
         }   
 
-        motionParameter nextTarget(unsigned int index) {
+        motionParameter nextTarget(unsigned int index) final {
             // maximum speed of the trapezoidal motion 
-            _nextMove.speed = int(1.5 * _stroke/_timeOfStroke);
+            _nextMove.speed = _profile.speed(_stroke);
 
             // acceleration to meet the profile
-            _nextMove.acceleration = int(3.0 * _nextMove.speed/_timeOfStroke);
+            _nextMove.acceleration = _profile.acceleration(_nextMove.speed);
 
             // odd stroke is moving out    
             if (index % 2) {
@@ -197,7 +281,7 @@ class SimpleStroke : public Pattern {
 /**************************************************************************/
 class TeasingPounding : public Pattern {
     public:
-        TeasingPounding(const char *str) : Pattern(str) {}
+        TeasingPounding(const char *str) : Pattern(str) { _type = PATTERN_TEASING_POUNDING; }
         void setSensation(float sensation) { 
             _sensation = sensation;
             _updateStrokeTiming();
@@ -206,22 +290,22 @@ class TeasingPounding : public Pattern {
             _timeOfStroke = speed;
             _updateStrokeTiming();
         }
-        motionParameter nextTarget(unsigned int index) {
+        motionParameter nextTarget(unsigned int index) final {
             // odd stroke is moving out
             if (index % 2) {
                 // maximum speed of the trapezoidal motion
-                _nextMove.speed = int(1.5 * _stroke/_timeOfOutStroke);
+                _nextMove.speed = _outProfile.speed(_stroke);
 
                 // acceleration to meet the profile                  
-                _nextMove.acceleration = int(3.0 * float(_nextMove.speed)/_timeOfOutStroke);    
+                _nextMove.acceleration = _outProfile.acceleration(_nextMove.speed);    
                 _nextMove.stroke = _depth - _stroke;
             // even stroke is moving in
             } else {
                 // maximum speed of the trapezoidal motion
-                _nextMove.speed = int(1.5 * _stroke/_timeOfInStroke); 
+                _nextMove.speed = _inProfile.speed(_stroke); 
      
                 // acceleration to meet the profile            
-                _nextMove.acceleration = int(3.0 * float(_nextMove.speed)/_timeOfInStroke);    
+                _nextMove.acceleration = _inProfile.acceleration(_nextMove.speed);    
                 _nextMove.stroke = _depth;
             }
             _index = index;
@@ -231,6 +315,8 @@ class TeasingPounding : public Pattern {
         float _timeOfFastStroke = 1.0;
         float _timeOfInStroke = 1.0;
         float _timeOfOutStroke = 1.0;
+        TrapezoidProfile _inProfile;
+        TrapezoidProfile _outProfile;
         void _updateStrokeTiming() {
             // calculate the time it takes to complete the faster stroke
             // Division by 2 because reference is a half stroke
@@ -244,10 +330,8 @@ class TeasingPounding : public Pattern {
                 _timeOfOutStroke = _timeOfFastStroke;
                 _timeOfInStroke = _timeOfStroke - _timeOfFastStroke;
             }
-#ifdef DEBUG_PATTERN
-            Serial.println("TimeOfInStroke: " + String(_timeOfInStroke));
-            Serial.println("TimeOfOutStroke: " + String(_timeOfOutStroke));
-#endif
+            _inProfile.setTime(_timeOfInStroke);
+            _outProfile.setTime(_timeOfOutStroke);
         }
 };
 
@@ -262,11 +346,12 @@ class TeasingPounding : public Pattern {
 /**************************************************************************/ 
 class RoboStroke : public Pattern {
     public:
-        RoboStroke(const char *str) : Pattern(str) {}
+        RoboStroke(const char *str) : Pattern(str) { _type = PATTERN_ROBO_STROKE; }
 
         void setTimeOfStroke(float speed = 0) { 
              // In & Out have same time, so we need to divide by 2
             _timeOfStroke = 0.5 * speed; 
+            _profile.setTime(_timeOfStroke, _x);
         }
 
         void setSensation(float sensation = 0) { 
@@ -277,18 +362,15 @@ class RoboStroke : public Pattern {
             } else {
               _x = fscale(0.0, 100.0, 1.0/3.0, 0.05, -sensation, 0.0);
             }
-#ifdef DEBUG_PATTERN
-            Serial.println("Sensation:" + String(sensation,0) + " --> " + String(_x,6));
-#endif
+            _profile.setTime(_timeOfStroke, _x);
         }
 
-        motionParameter nextTarget(unsigned int index) {
+        motionParameter nextTarget(unsigned int index) final {
             // maximum speed of the trapezoidal motion
-            float speed = float(_stroke) / ((1 - _x) * _timeOfStroke);
-            _nextMove.speed = int(speed); 
+            _nextMove.speed = _profile.speed(_stroke); 
 
             // acceleration to meet the profile
-            _nextMove.acceleration = int(speed / (_x * _timeOfStroke));
+            _nextMove.acceleration = _profile.acceleration(_nextMove.speed);
 
             // odd stroke is moving out    
             if (index % 2) {
@@ -318,7 +400,7 @@ class RoboStroke : public Pattern {
 /**************************************************************************/
 class HalfnHalf : public Pattern {
     public:
-        HalfnHalf(const char *str) : Pattern(str) {}
+        HalfnHalf(const char *str) : Pattern(str) { _type = PATTERN_HALF_N_HALF; }
         void setSensation(float sensation) { 
             _sensation = sensation;
             _updateStrokeTiming();
@@ -327,12 +409,11 @@ class HalfnHalf : public Pattern {
             _timeOfStroke = speed;
             _updateStrokeTiming();
         }
-        motionParameter nextTarget(unsigned int index) {
-            // check if this is the very first 
-            if (index == 0) {
-              //pattern started for the very fist time, so we start gentle with a half move
-              _half = true;
-            }
+        motionParameter nextTarget(unsigned int index) final {
+            // every second in & out move is half. Derived from the index, so 
+            // the stroke can be computed again or ahead of time.
+            // Pattern starts gentle with a half move at index 0.
+            _half = ((index / 2) % 2 == 0);
 
             // set-up the stroke length
             int stroke = _stroke;
@@ -344,20 +425,18 @@ class HalfnHalf : public Pattern {
             // odd stroke is moving out
             if (index % 2) {
                 // maximum speed of the trapezoidal motion
-                _nextMove.speed = int(1.5 * stroke/_timeOfOutStroke);  
+                _nextMove.speed = _outProfile.speed(stroke);  
 
                 // acceleration to meet the profile                  
-                _nextMove.acceleration = int(3.0 * float(_nextMove.speed)/_timeOfOutStroke);    
+                _nextMove.acceleration = _outProfile.acceleration(_nextMove.speed);    
                 _nextMove.stroke = _depth - _stroke;
-                // every second move is half
-                _half = !_half;
             // even stroke is moving in
             } else {
                 // maximum speed of the trapezoidal motion
-                _nextMove.speed = int(1.5 * stroke/_timeOfInStroke);  
+                _nextMove.speed = _inProfile.speed(stroke);  
      
                 // acceleration to meet the profile            
-                _nextMove.acceleration = int(3.0 * float(_nextMove.speed)/_timeOfInStroke);    
+                _nextMove.acceleration = _inProfile.acceleration(_nextMove.speed);    
                 _nextMove.stroke = (_depth - _stroke) + stroke;  
             }
             _index = index;
@@ -367,6 +446,8 @@ class HalfnHalf : public Pattern {
         float _timeOfFastStroke = 1.0;
         float _timeOfInStroke = 1.0;
         float _timeOfOutStroke = 1.0;
+        TrapezoidProfile _inProfile;
+        TrapezoidProfile _outProfile;
         bool _half = true;
         void _updateStrokeTiming() {
             // calculate the time it takes to complete the faster stroke
@@ -381,10 +462,8 @@ class HalfnHalf : public Pattern {
                 _timeOfOutStroke = _timeOfFastStroke;
                 _timeOfInStroke = _timeOfStroke - _timeOfFastStroke;
             }
-#ifdef DEBUG_PATTERN
-            Serial.println("TimeOfInStroke: " + String(_timeOfInStroke));
-            Serial.println("TimeOfOutStroke: " + String(_timeOfOutStroke));
-#endif
+            _inProfile.setTime(_timeOfInStroke);
+            _outProfile.setTime(_timeOfOutStroke);
         }
 };
 
@@ -397,11 +476,12 @@ class HalfnHalf : public Pattern {
 /**************************************************************************/
 class Deeper : public Pattern {
     public:
-        Deeper(const char *str) : Pattern(str) {}
+        Deeper(const char *str) : Pattern(str) { _type = PATTERN_DEEPER; }
 
         void setTimeOfStroke(float speed = 0) { 
              // In & Out have same time, so we need to divide by 2
             _timeOfStroke = 0.5 * speed; 
+            _profile.setTime(_timeOfStroke);
         }   
 
         void setSensation(float sensation) { 
@@ -413,12 +493,9 @@ class Deeper : public Pattern {
             } else {
                 _countStrokesForRamp = map(sensation, 0, 100, 11, 32);
             }
-#ifdef DEBUG_PATTERN
-            Serial.println("_countStrokesForRamp: " + String(_countStrokesForRamp));
-#endif
         }
 
-        motionParameter nextTarget(unsigned int index) {
+        motionParameter nextTarget(unsigned int index) final {
             // How many steps is each stroke advancing         
             int slope = _stroke / (_countStrokesForRamp);
 
@@ -428,20 +505,17 @@ class Deeper : public Pattern {
             int cycleIndex = (index / 2) % _countStrokesForRamp + 1;
 
             // This might be not smooth, as the insertion depth may jump when 
-            // sensation is adjusted.
+            // sensation is adjusted. StrokeEngine::setRamp() spreads the change
+            // over several strokes.
 
             // Amplitude is slope * cycleIndex
             int amplitude = slope * cycleIndex;
-#ifdef DEBUG_PATTERN
-            Serial.println("amplitude: " + String(amplitude)
-                         + " cycleIndex: " + String(cycleIndex));
-#endif
 
             // maximum speed of the trapezoidal motion 
-            _nextMove.speed = int(1.5 * amplitude/_timeOfStroke); 
+            _nextMove.speed = _profile.speed(amplitude); 
 
             // acceleration to meet the profile
-            _nextMove.acceleration = int(3.0 * _nextMove.speed/_timeOfStroke);
+            _nextMove.acceleration = _profile.acceleration(_nextMove.speed);
 
             // odd stroke is moving out    
             if (index % 2) {
@@ -470,11 +544,17 @@ class Deeper : public Pattern {
 /**************************************************************************/
 class StopNGo : public Pattern {
     public:
-        StopNGo(const char *str) : Pattern(str) {}
+        StopNGo(const char *str) : Pattern(str) { 
+            _type = PATTERN_STOP_N_GO;
+
+            // pauses are timed with millis(), so strokes must not be precomputed
+            _allowLookahead = false; 
+        }
 
         void setTimeOfStroke(float speed = 0) { 
              // In & Out have same time, so we need to divide by 2
             _timeOfStroke = 0.5 * speed; 
+            _profile.setTime(_timeOfStroke);
         }   
 
         void setSensation(float sensation) { 
@@ -484,12 +564,12 @@ class StopNGo : public Pattern {
             _updateDelay(map(sensation, -100, 100, 100, 10000));
         }
 
-        motionParameter nextTarget(unsigned int index) {
+        motionParameter nextTarget(unsigned int index) final {
             // maximum speed of the trapezoidal motion 
-            _nextMove.speed = int(1.5 * _stroke/_timeOfStroke); 
+            _nextMove.speed = _profile.speed(_stroke); 
 
             // acceleration to meet the profile
-            _nextMove.acceleration = int(3.0 * _nextMove.speed/_timeOfStroke);
+            _nextMove.acceleration = _profile.acceleration(_nextMove.speed);
 
             // adds a delay between each stroke
             if (_isStillDelayed() == false) {
@@ -558,7 +638,7 @@ class StopNGo : public Pattern {
 /**************************************************************************/
 class Insist : public Pattern {
     public:
-        Insist(const char *str) : Pattern(str) {}   
+        Insist(const char *str) : Pattern(str) { _type = PATTERN_INSIST; }
 
         void setSensation(float sensation) { 
             _sensation = sensation;
@@ -582,7 +662,7 @@ class Insist : public Pattern {
             _updateStrokeTiming();
         }
 
-        motionParameter nextTarget(unsigned int index) {
+        motionParameter nextTarget(unsigned int index) final {
 
             // acceleration & speed to meet the profile
             _nextMove.acceleration = _acceleration;
@@ -622,10 +702,14 @@ class Insist : public Pattern {
         bool _strokeInFront = false;
         void _updateStrokeTiming() {
             // maximum speed of the longest trapezoidal motion (full stroke)
-            _speed = int(1.5 * _stroke/_timeOfStroke);
+            _profile.setTime(_timeOfStroke);
+            _speed = _profile.speed(_stroke);
 
-            // Acceleration to hold 1/3 profile with fractional strokes
-            _acceleration = int(3.0 * _nextMove.speed/(_timeOfStroke * _strokeFraction));
+            // Acceleration to hold 1/3 profile with fractional strokes, 
+            // which take the fraction of the time at the same speed
+            TrapezoidProfile fractional;
+            fractional.setTime(_timeOfStroke * _strokeFraction);
+            _acceleration = fractional.acceleration(_speed);
 
             // Calculate fractional stroke length
             _realStroke = int((float)_stroke * _strokeFraction);
@@ -633,20 +717,444 @@ class Insist : public Pattern {
 
 };
 
+#ifndef KEYFRAME_CACHE_SIZE
+  #define KEYFRAME_CACHE_SIZE   16    // Maximum number of keyframes of a KeyframePattern
+#endif
+
+/**************************************************************************/
+/*!
+  @brief  Easing of the move towards a keyframe. Selects the share of the 
+  move's time spent accelerating and decelerating of the trapezoidal profile.
+*/
+/**************************************************************************/
+typedef enum {
+  EASE_LINEAR,        //!< Near constant speed with short ramps (5%), feels robotic
+  EASE_SMOOTH,        //!< 1/3 accelerate, 1/3 coast, 1/3 decelerate like Simple Stroke
+  EASE_SOFT           //!< Triangle profile, accelerates the first half and decelerates the second half
+} keyframeEasing;
+
+/**************************************************************************/
+/*!
+  @brief  One keyframe of a KeyframePattern. A keyframe is the end point of a
+  move, the move starts at the previous keyframe. The table is cyclic, so the
+  first keyframe is approached from the last one. Positions are relative to 
+  the stroke interval, so depth and stroke stay in effect. Sensation may shift
+  the position and stretch the duration of each keyframe. 5 bytes without 
+  padding, so tables can be stored in flash or in a binary file.
+*/
+/**************************************************************************/
+typedef struct {
+    uint8_t position;           //!< Target in percent of stroke. 0 = depth - stroke, 100 = depth
+    uint8_t duration;           //!< Weight of the move's duration. All weights of a table add up to the time of stroke.
+    uint8_t easing;             //!< keyframeEasing of the move
+    int8_t sensationPosition;   //!< Position shift in percent of stroke at sensation = 100. Scales linearly with sensation.
+    int8_t sensationTime;       //!< Duration change in percent at sensation = 100. Scales linearly with sensation.
+} keyframe;
+
+/**************************************************************************/
+/*!
+  @brief  Generic pattern evaluating a table of keyframes instead of code. 
+  Speed, acceleration and position of every keyframe are evaluated once
+  whenever a parameter changes. nextTarget() is then a lookup into this cache.
+  The table itself is not copied and may reside in flash. The time of stroke 
+  is the time of one full cycle through the table. Sensation changes the 
+  ratio of the durations, but not the time of a full cycle.
+*/
+/**************************************************************************/
+class KeyframePattern : public Pattern {
+    public:
+        //! Constructor
+        /*!
+          @param str name of the pattern
+          @param keyframes pointer to the keyframe table. Must stay valid as long as the pattern is used.
+          @param count number of keyframes, at most KEYFRAME_CACHE_SIZE. Longer tables are truncated.
+          @param mode TRAJECTORY_BLEND passes through keyframes continuing in the same direction
+        */
+        KeyframePattern(const char *str, const keyframe *keyframes, unsigned int count, trajectoryMode mode = TRAJECTORY_STOP) : Pattern(str) { 
+            _type = PATTERN_KEYFRAME;
+            _trajectoryMode = mode;
+            setKeyframes(keyframes, count);
+        }
+
+        //! Replace the keyframe table
+        /*!
+          @param keyframes pointer to the keyframe table. Must stay valid as long as the pattern is used.
+          @param count number of keyframes, at most KEYFRAME_CACHE_SIZE. Longer tables are truncated.
+        */
+        void setKeyframes(const keyframe *keyframes, unsigned int count) {
+            _keyframes = keyframes;
+            _count = min(count, (unsigned int)KEYFRAME_CACHE_SIZE);
+            _updateCache();
+        }
+
+        void setTimeOfStroke(float speed = 0) { 
+            _timeOfStroke = speed;
+            _updateCache();
+        }
+
+        void setStroke(int stroke) {
+            _stroke = stroke;
+            _updateCache();
+        }
+
+        void setDepth(int depth) {
+            _depth = depth;
+            _updateCache();
+        }
+
+        void setSensation(float sensation) { 
+            _sensation = sensation;
+            _updateCache();
+        }
+
+        motionParameter nextTarget(unsigned int index) final {
+            _index = index;
+
+            // An empty table holds the position
+            if (_count == 0) {
+                _nextMove.skip = true;
+                return _nextMove;
+            }
+
+            _nextMove = _cache[index % _count];
+            return _nextMove;
+        }
+
+    protected:
+        const keyframe *_keyframes = NULL;
+        unsigned int _count = 0;
+        motionParameter _cache[KEYFRAME_CACHE_SIZE];
+
+        // Target of a keyframe in steps
+        int _keyframePosition(unsigned int i) {
+            float position = _keyframes[i].position + _keyframes[i].sensationPosition * _sensation / 100.0f;
+            position = constrain(position, 0.0f, 100.0f);
+            return (_depth - _stroke) + int(_stroke * position / 100.0f);
+        }
+
+        // Evaluate all keyframes into motion parameters
+        void _updateCache() {
+            if ((_keyframes == NULL) || (_count == 0)) {
+                return;
+            }
+
+            // Durations stretched by sensation, never below 10% of the original weight
+            float weight[KEYFRAME_CACHE_SIZE];
+            float sumOfWeights = 0.0;
+            for (unsigned int i = 0; i < _count; i++) {
+                float stretch = 1.0f + _keyframes[i].sensationTime * _sensation / 10000.0f;
+                weight[i] = _keyframes[i].duration * max(stretch, 0.1f);
+                sumOfWeights += weight[i];
+            }
+
+            for (unsigned int i = 0; i < _count; i++) {
+                int from = _keyframePosition((i + _count - 1) % _count);
+                int to = _keyframePosition(i);
+                float time = (sumOfWeights > 0.0f) ? (_timeOfStroke * weight[i] / sumOfWeights) : 0.0f;
+
+                float accelerationShare = 1.0f/3.0f;
+                if (_keyframes[i].easing == EASE_LINEAR) {
+                    accelerationShare = 0.05f;
+                } else if (_keyframes[i].easing == EASE_SOFT) {
+                    accelerationShare = 0.5f;
+                }
+
+                TrapezoidProfile profile;
+                profile.setTime(time, accelerationShare);
+                _cache[i].stroke = to;
+                _cache[i].speed = max(profile.speed(abs(to - from)), 1);
+                _cache[i].acceleration = max(profile.acceleration(_cache[i].speed), 1);
+                _cache[i].skip = false;
+                _cache[i].jerk = 0;
+            }
+        }
+};
+
 /**************************************************************************/
-/*
-  Array holding all different patterns. Please include any custom pattern here.
+/*!
+  @brief  One point of a recorded stroke sequence. 4 bytes, so sequences can 
+  be stored in flash or in a binary file.
+*/
+/**************************************************************************/
+typedef struct {
+    uint16_t position;          //!< Target in 1/100 percent of stroke. 0 = depth - stroke, 10000 = depth
+    uint16_t duration;          //!< Time to reach the target in [ms] at a time of stroke of 1s
+} sequencePoint;
+
+/**************************************************************************/
+/*!
+  @brief  Plays back a recorded sequence of positions, e.g. a funscript 
+  converted into a PatternFile. The sequence is not copied and is read in 
+  place, so it may reside in flash or in a memory mapped file. The time of 
+  stroke scales the playback speed: 1s plays the sequence as recorded, 0.5s 
+  twice as fast. A point at the position of the previous point is a pause 
+  and holds the position for its duration. The sequence repeats when it 
+  reaches its end. Sensation has no effect.
+*/
+/**************************************************************************/
+class SequencePattern : public Pattern {
+    public:
+        //! Constructor
+        /*!
+          @param str name of the pattern
+          @param points pointer to the sequence. Must stay valid as long as the pattern is used.
+          @param count number of points
+          @param mode TRAJECTORY_BLEND passes through points continuing in the same direction
+        */
+        SequencePattern(const char *str, const sequencePoint *points = NULL, unsigned int count = 0, trajectoryMode mode = TRAJECTORY_STOP) : Pattern(str) { 
+            _type = PATTERN_SEQUENCE;
+            _trajectoryMode = mode;
+            setSequence(points, count);
+        }
+
+        //! Replace the sequence
+        /*!
+          @param points pointer to the sequence. Must stay valid as long as the pattern is used.
+          @param count number of points
+        */
+        void setSequence(const sequencePoint *points, unsigned int count) {
+            _points = points;
+            _count = (points != NULL) ? count : 0;
+            _holdIndex = -1;
+
+            // Pauses run on millis(), so they must not be queried ahead of time
+            _allowLookahead = true;
+            for (unsigned int i = 0; i < _count; i++) {
+                if (_isPause(i)) {
+                    _allowLookahead = false;
+                    break;
+                }
+            }
+        }
+
+        motionParameter nextTarget(unsigned int index) final {
+            _index = index;
+
+            // An empty sequence holds the position
+            if (_count == 0) {
+                _nextMove.skip = true;
+                return _nextMove;
+            }
+
+            int from = _pointPosition((index + _count - 1) % _count);
+            int to = _pointPosition(index % _count);
+            float time = _points[index % _count].duration * _timeOfStroke / 1000.0f;
+
+            // Hold the position of a pause until its scaled duration has passed
+            if (_isPause(index % _count) && _isHolding(index, int(time * 1000.0f))) {
+                _nextMove.skip = true;
+                return _nextMove;
+            }
+
+            TrapezoidProfile profile;
+            profile.setTime(time);
+            _nextMove.stroke = to;
+            _nextMove.speed = max(profile.speed(abs(to - from)), 1);
+            _nextMove.acceleration = max(profile.acceleration(_nextMove.speed), 1);
+            _nextMove.skip = false;
+            return _nextMove;
+        }
+
+    protected:
+        const sequencePoint *_points = NULL;
+        unsigned int _count = 0;
+
+        // Target of a point in steps
+        int _pointPosition(unsigned int i) {
+            int position = min(_points[i].position, (uint16_t)10000);
+            return (_depth - _stroke) + int((int64_t(_stroke) * position) / 10000);
+        }
+
+        // A point at the position of the previous point
+        bool _isPause(unsigned int i) {
+            return _points[i].position == _points[(i + _count - 1) % _count].position;
+        }
+};
+
+/**************************************************************************/
+/*!
+  @brief  Plays a script compiled offline by the funscript compiler in 
+  extras/. Speed and acceleration of every move were planned and clipped 
+  against the machine limits beforehand, so playback only scales the 
+  normalized values with the stroke. The stream is read in place, e.g. from
+  a memory mapped PatternFile, where the flash cache pages it in on access.
+  A move to the position of the previous move is a pause and holds the 
+  position for its duration. The script repeats when it reaches its end. 
+  Time of stroke and sensation have no effect, as the timing is part of the 
+  script.
+*/
+/**************************************************************************/
+class SequencePlayer : public Pattern {
+    public:
+        //! Constructor
+        /*!
+          @param str name of the pattern
+          @param moves pointer to the compiled moves. Must stay valid as long as the pattern is used.
+          @param count number of moves
+          @param mode TRAJECTORY_BLEND passes through moves continuing in the same direction
+        */
+        SequencePlayer(const char *str, const plannedMove *moves = NULL, unsigned int count = 0, trajectoryMode mode = TRAJECTORY_STOP) : Pattern(str) { 
+            _type = PATTERN_PLAYER;
+            _trajectoryMode = mode;
+            setMoves(moves, count);
+        }
+
+        //! Replace the compiled moves
+        /*!
+          @param moves pointer to the compiled moves. Must stay valid as long as the pattern is used.
+          @param count number of moves
+        */
+        void setMoves(const plannedMove *moves, unsigned int count) {
+            _moves = moves;
+            _count = (moves != NULL) ? count : 0;
+            _holdIndex = -1;
+
+            // Pauses run on millis(), so they must not be queried ahead of time
+            _allowLookahead = true;
+            for (unsigned int i = 0; i < _count; i++) {
+                if (_isPause(i)) {
+                    _allowLookahead = false;
+                    break;
+                }
+            }
+        }
+
+        motionParameter nextTarget(unsigned int index) final {
+            _index = index;
+
+            // An empty script holds the position
+            if (_count == 0) {
+                _nextMove.skip = true;
+                return _nextMove;
+            }
+
+            const plannedMove &move = _moves[index % _count];
+
+            // Hold the position of a pause until its duration has passed
+            if (_isPause(index % _count) && _isHolding(index, move.duration)) {
+                _nextMove.skip = true;
+                return _nextMove;
+            }
+
+            _nextMove.stroke = (_depth - _stroke) + int((int64_t(_stroke) * min(move.position, (uint16_t)10000)) / 10000);
+            _nextMove.speed = max(fixedMultiply(_stroke, fixed_t(move.speed)), 1);
+            _nextMove.acceleration = max(fixedMultiply(_stroke, fixed_t(move.acceleration)), 1);
+            _nextMove.skip = false;
+            return _nextMove;
+        }
+
+    protected:
+        const plannedMove *_moves = NULL;
+        unsigned int _count = 0;
+
+        // A move to the position of the previous move
+        bool _isPause(unsigned int i) {
+            return _moves[i].position == _moves[(i + _count - 1) % _count].position;
+        }
+};
+
+/**************************************************************************/
+/*!
+  @brief  Calls nextTarget() of a pattern. Built-in patterns are called with a
+  qualified, non-virtual call that the compiler can inline into the stroking 
+  task. Their nextTarget() is final, so no derived class can be bypassed. 
+  Custom patterns are dispatched through the vtable as before.
+  @param pattern pattern to query
+  @param index index of the stroke
+  @return motion parameters of the stroke
+*/
+/**************************************************************************/
+inline motionParameter dispatchNextTarget(Pattern *pattern, unsigned int index) {
+    switch (pattern->getType()) {
+        case PATTERN_SIMPLE_STROKE:
+            return static_cast<SimpleStroke*>(pattern)->SimpleStroke::nextTarget(index);
+        case PATTERN_TEASING_POUNDING:
+            return static_cast<TeasingPounding*>(pattern)->TeasingPounding::nextTarget(index);
+        case PATTERN_ROBO_STROKE:
+            return static_cast<RoboStroke*>(pattern)->RoboStroke::nextTarget(index);
+        case PATTERN_HALF_N_HALF:
+            return static_cast<HalfnHalf*>(pattern)->HalfnHalf::nextTarget(index);
+        case PATTERN_DEEPER:
+            return static_cast<Deeper*>(pattern)->Deeper::nextTarget(index);
+        case PATTERN_STOP_N_GO:
+            return static_cast<StopNGo*>(pattern)->StopNGo::nextTarget(index);
+        case PATTERN_INSIST:
+            return static_cast<Insist*>(pattern)->Insist::nextTarget(index);
+        case PATTERN_KEYFRAME:
+            return static_cast<KeyframePattern*>(pattern)->KeyframePattern::nextTarget(index);
+        case PATTERN_SEQUENCE:
+            return static_cast<SequencePattern*>(pattern)->SequencePattern::nextTarget(index);
+        case PATTERN_PLAYER:
+            return static_cast<SequencePlayer*>(pattern)->SequencePlayer::nextTarget(index);
+        default:
+            return pattern->nextTarget(index);
+    }
+}
+
+#ifndef MAX_CUSTOM_PATTERNS
+  #define MAX_CUSTOM_PATTERNS   8     // Number of patterns that can be added with REGISTER_PATTERN()
+#endif
+
+/**************************************************************************/
+/*!
+  @class PatternRegistry
+  @brief  Single list of all patterns shared by StrokeEngine and the main 
+          program. Built-in patterns are statically allocated in pattern.cpp 
+          and their table is constant, so no pattern needs any heap. Custom 
+          patterns are appended behind the built-in ones with REGISTER_PATTERN() 
+          in the order they are registered.
+*/
+/**************************************************************************/
+class PatternRegistry {
+
+    public:
+        //! Retrieve a pattern
+        /*! 
+          @param index index of a pattern
+          @return pointer to the pattern, NULL if index is out of range
+        */
+        static Pattern *get(unsigned int index);
+
+        //! Number of registered patterns
+        /*! 
+          @return number of built-in plus custom patterns
+        */
+        static unsigned int size();
+
+        //! Append a custom pattern. Use REGISTER_PATTERN() instead of calling this directly.
+        /*! 
+          @param pattern pointer to a statically allocated pattern
+          @return true on success, false if MAX_CUSTOM_PATTERNS is exceeded
+        */
+        static bool add(Pattern *pattern);
+};
+
+//! Helper for REGISTER_PATTERN(), registers a pattern during static initialization
+class PatternRegistrar {
+    public:
+        PatternRegistrar(Pattern *pattern) { PatternRegistry::add(pattern); }
+};
+
+/**************************************************************************/
+/*!
+  @brief  Adds a custom pattern to the registry without touching the library. 
+  Place it once per pattern at file scope of any source file, e.g. the main 
+  sketch. The pattern is statically allocated.
+  @param Type class name of the pattern
+  @param name name of the pattern as shown by getPatternName()
+*/
+/**************************************************************************/
+#define REGISTER_PATTERN(Type, name) \
+    static Type _registeredPattern##Type(name); \
+    static PatternRegistrar _patternRegistrar##Type(&_registeredPattern##Type)
+
+/**************************************************************************/
+/*!
+  @brief  Adds an existing, statically allocated pattern to the registry. Use
+  it for patterns whose constructor takes more than a name, like 
+  KeyframePattern or SequencePattern. Place it at file scope.
+  @param instance pattern object
 */
 /**************************************************************************/
-static Pattern *patternTable[] = { 
-  new SimpleStroke("Simple Stroke"),
-  new TeasingPounding("Teasing or Pounding"),
-  new RoboStroke("Robo Stroke"),
-  new HalfnHalf("Half'n'Half"),
-  new Deeper("Deeper"),
-  new StopNGo("Stop'n'Go"),
-  new Insist("Insist")
-  // <-- insert your new pattern class here!
- };
-
-static const unsigned int patternTableSize = sizeof(patternTable) / sizeof(patternTable[0]);
+#define REGISTER_PATTERN_INSTANCE(instance) \
+    static PatternRegistrar _patternRegistrar##instance(&instance)
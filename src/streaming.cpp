@@ -0,0 +1,16 @@
+/**
+ *   Streaming Buffer of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo motor on an ESP32.
+ *   https://github.com/theelims/StrokeEngine 
+ *
+ * Copyright (C) 2022 theelims <elims@gmx.net>
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include "streaming.h"
+
+// Single statically allocated streaming buffer shared by all translation units
+static LivePosition livePositionInstance;
+LivePosition * const livePosition = &livePositionInstance;
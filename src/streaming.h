@@ -1,35 +1,83 @@
 #include <pattern.h>
-#include <CircularBuffer.h>
+#include <SPSCQueue.h>
+
+#ifndef STREAMING_QUEUE_DEPTH
+  #define STREAMING_QUEUE_DEPTH 64    // Number of points the streaming buffer holds. Must be a power of two.
+#endif
 
 class Movement {
     public:
         Movement() {};
-        Movement(unsigned int position, unsigned int time) {
+        Movement(unsigned int position, unsigned int time, bool absolute = false) {
             _position = position;
             _time = time;
+            _absolute = absolute;
         }
         ~Movement() {};
         
         unsigned int position() {
             return _position;
         }
+        // Duration of the move in ms, or the timestamp in ms of the streaming 
+        // clock at which the position must be reached, if isAbsolute()
         unsigned int time() {
             return _time;
         }
+        bool isAbsolute() {
+            return _absolute;
+        }
     private:
         unsigned int _position;
         unsigned int _time;
+        bool _absolute = false;
 };
 
 class LivePosition : public Pattern {
     public:
         LivePosition() : Pattern("") {}
 
-        void addPosition(unsigned int position, unsigned int time) {
-            pendingMovements.push(new Movement(position, time));
+        // Producer side, may be called from any single task without locking. 
+        // Movements are stored by value, so streaming causes no heap traffic. 
+        // Returns false if the buffer is full and the movement was dropped.
+        bool addPosition(unsigned int position, unsigned int time) {
+            Movement movement(position, time);
+            return addPositions(&movement, 1) == 1;
+        }
+        // Appends several movements at once. Returns the number of accepted movements.
+        size_t addPositions(const Movement *movements, size_t count) {
+            size_t accepted = pendingMovements.push(movements, count);
+            _dropped += count - accepted;
+            return accepted;
+        }
+        // Number of movements that can be added before the buffer is full
+        size_t available() {
+            return pendingMovements.available();
+        }
+        // Total number of movements the buffer holds
+        size_t capacity() {
+            return pendingMovements.capacity();
+        }
+        // Number of movements rejected because the buffer was full
+        unsigned long dropped() {
+            return _dropped;
         }
+        // Discards all pending movements. Movements added afterwards are kept.
         void clear() {
-            pendingMovements.clear();
+            pendingMovements.flush();
+        }
+        // Aligns the streaming clock of absolute movements with millis(): 
+        // a timestamp t is due at millis() == t + offset
+        void setClockOffset(long offset) {
+            _clockOffset = offset;
+        }
+
+        // Real state of the axis the next movement starts from and millis() 
+        // at that moment. Must be updated by the StrokeEngine right before 
+        // calling nextTarget(). Passing the time keeps moves reproducible.
+        void setActualState(int position, int speed, unsigned long now) {
+            _actualPosition = position;
+            _actualSpeed = speed;
+            _now = now;
         }
 
         void setTimeOfStroke(float speed = 0) { 
@@ -37,34 +85,81 @@ class LivePosition : public Pattern {
         }
 
         motionParameter nextTarget(int index) {
-            if (pendingMovements.isEmpty()) { // no more pending movements
-                _nextMove.skip = true;
-            } else if (_currentMovement == NULL) { // function tried to re-use last index but we have no last movement stored
+            if ((index == _index) && _hasCurrentMovement) { // re-use last index: recalculate the current movement, e.g. after depth or stroke changed
+                _calculateMove(_currentMovement);
+            } else if (pendingMovements.isEmpty()) { // no more pending movements
                 _nextMove.skip = true;
+                // don't advance _index, the same index is queried again
+                return _nextMove;
             } else {
                 // pull the next position + time value from the circular buffer and set StrokeEngine to move to it
-                _currentMovement = pendingMovements.shift();
-                _timeOfStroke = constrain(_currentMovement->time() / 1000.0, 0.01, 120.0); // seconds to complete a half stroke
-                int newPos = _currentMovement->position() * (_depth - (_depth - _stroke)) / 100 + (_depth - _stroke); // convert from 0-100 to StrokeEngine stroke value
-                int distance = abs(_lastPos - newPos); // TODO: this distance is incorrect when applyNow is true, need to know actual current position
-                _nextMove.stroke = newPos;
-
-                // maximum speed of the trapezoidal motion 
-                _nextMove.speed = int(1.5 * (distance/_timeOfStroke));
-                
-                // acceleration to meet the profile
-                _nextMove.acceleration = int(3.0 * _nextMove.speed/_timeOfStroke);
-                _nextMove.skip = false;
-                _lastPos = newPos;
+                pendingMovements.pop(_currentMovement);
+                _hasCurrentMovement = true;
+                _calculateMove(_currentMovement);
             }
 
             _index = index;
             return _nextMove;
         }
     private:
-        CircularBuffer<Movement*, 10> pendingMovements;
-        Movement* _currentMovement;
-        int _lastPos = 0;
+        SPSCQueue<Movement, STREAMING_QUEUE_DEPTH> pendingMovements;
+        Movement _currentMovement;
+        bool _hasCurrentMovement = false;
+        int _actualPosition = 0;
+        int _actualSpeed = 0;
+        unsigned long _now = 0;
+        volatile long _clockOffset = 0;
+        unsigned long _dropped = 0;
+
+        void _calculateMove(Movement movement) {
+            float duration = movement.time() / 1000.0;
+            if (movement.isAbsolute()) {
+                // Plan with the time that is actually left until the point is due. This
+                // compensates late dequeues and keeps long sessions in sync with the source.
+                long remaining = long((unsigned long)movement.time() + (unsigned long)_clockOffset - _now);
+                duration = remaining / 1000.0;
+            }
+            _timeOfStroke = constrain(duration, 0.01, 120.0); // seconds to complete a half stroke
+            int newPos = movement.position() * (_depth - (_depth - _stroke)) / 100 + (_depth - _stroke); // convert from 0-100 to StrokeEngine stroke value
+            _nextMove.stroke = newPos;
+
+            // Plan from the real axis state, which differs from the last target
+            // after clipping or when a move is re-planned while running
+            float distance = float(newPos - _actualPosition);
+            float v0 = (distance >= 0) ? float(_actualSpeed) : float(-_actualSpeed);
+            distance = fabs(distance);
+
+            // Moving away from the target: plan from standstill, the stepper 
+            // reverses with the planned acceleration
+            if (v0 < 0.0) {
+                v0 = 0.0;
+            }
+
+            // Trapezoid starting at v0 with 1/3 of the time cruising at top speed v
+            // and acceleration a for both ramps. Solving 
+            //   distance = (2v² - v0²) / 2a + v * T/3  with  a = 3 (2v - v0) / 2T
+            // for v gives the profile reaching the target in the remaining time T.
+            // With v0 = 0 this is the familiar v = 1.5 d/T, a = 3 v/T.
+            float T = _timeOfStroke;
+            float b = v0 + 6.0f * distance / T;
+            float c = 3.0f * distance * v0 / T - v0 * v0;
+            float v = (b + sqrtf(b * b - 16.0f * c)) / 8.0f;
+            float a = 3.0f * (2.0f * v - v0) / (2.0f * T);
+
+            // Already faster than needed: just brake into the target
+            if (v < v0) {
+                v = v0;
+                a = (distance > 0.0f) ? (v0 * v0) / (2.0f * distance) : a;
+            }
+
+            // maximum speed of the trapezoidal motion 
+            _nextMove.speed = int(v);
+            
+            // acceleration to meet the profile
+            _nextMove.acceleration = int(a);
+            _nextMove.skip = false;
+        }
 };
 
-static LivePosition* livePosition = new LivePosition();
\ No newline at end of file
+// The streaming buffer, allocated once in streaming.cpp
+extern LivePosition * const livePosition;
\ No newline at end of file